@@ -0,0 +1,460 @@
+// Benchmark driver for findLongest.cpp
+//
+// Compilation:
+//   g++ -std=c++11 -O2 -pthread benchFindLongest.cpp -o benchFindLongest
+// The driver includes findLongest.cpp (without its main()) so it can time the
+// internal functions directly.
+//
+// Usage:  benchFindLongest [--filter=TEXT] [--min-time=SECONDS] [word_input_text_file ...]
+//   Without files, wordsforproblem.txt is used.  A synthetic corpus (random base
+//   words and compounds of them, from a fixed seed) is always added, so runs on
+//   different machines compare the same words.
+//
+// Each benchmark runs its body once to warm up, then doubles the iteration count
+// until the timed loop takes at least the minimum time (default 0.5 seconds), in
+// the style of Google Benchmark.  Results are printed per word:
+//   Benchmark                                      ns/word     words/sec  iterations
+// Benchmarks:
+//   cleanWord/<corpus>                  cleanWord() on a copy of every line
+//   ingest/<kernel>/<corpus>            lower casing a copy of the file, then finding and
+//                                       trimming every line, as the loaders do, with each
+//                                       ingest kernel the CPU supports
+//   hashStringFile/<corpus>             loading the file into the set and length map
+//   hashStringFile/j<N>/<corpus>        the same with the parallel loader, N hardware threads
+//   checkWord/<engine>/<kind>/<corpus>  one check per word, suffix cache disabled, for
+//                                       short (<= 6 letters) and long (>= 20 letters) words
+//   checkWord/<engine>/adversarial...   "a".."a" * n against "a" * n + "b", without the
+//                                       cache (n = 18) and with a fresh cache (n = 30)
+//   findLongestWordsOfWords/<engine>/<corpus>  the full search with a fresh suffix cache
+//   endToEnd/<corpus>                   load, index, and search, as main() does
+
+#define FL_NO_MAIN
+#include "findLongest.cpp"
+
+#include <functional>
+#include <random>
+#include <fstream>
+
+// Options of the driver.
+static std::string kBenchFilter = "";
+static double kBenchMinSeconds = 0.5;
+
+// Results of the benchmark bodies are added here, so the compiler cannot drop the work.
+static volatile unsigned long gBenchSink = 0;
+
+// A word list to benchmark:  the raw lines, read once, the lines joined back into the
+// file's text (each followed by a newline), and the file they came from.
+struct FLBenchCorpus {
+  std::string name;
+  std::string fileName;
+  std::vector<std::string> lines;
+  std::string text;
+};
+
+// Structures built from a corpus the way main() builds them for kEngine and kStore.
+struct FLBenchDictionary {
+  FLLengthMap *sizeHash;
+  FLStringSet *stringSet;
+  FLWordStorage *wordStorage;
+  FLFlatSet *flatSet;
+  FLTrie *trie;
+  FLAutomaton *automaton;
+  FLDoubleArray *doubleArray;
+  FLDawg *dawg;
+  FLBloomFilter *bloomFilter;
+  FLLengthMasks *lengthMasks;
+  size_t wordCount;
+  size_t maxWordLength;
+};
+
+// Function declarations, in definition order.
+void runBenchmark(const std::string &name, size_t wordsPerIteration, std::function<void()> body);
+void readCorpus(FLBenchCorpus *corpus, const std::string &name, const std::string &fileName);
+std::string writeTempCorpus(const std::vector<std::string> &words);
+void makeSyntheticWords(std::vector<std::string> &words, size_t baseCount, size_t compoundCount);
+void loadDictionary(FLBenchDictionary *dictionary, std::string fileName);
+void deleteDictionary(FLBenchDictionary *dictionary);
+void selectWords(FLBenchDictionary *dictionary, size_t minLength, size_t maxLength, size_t maxWords,
+		 std::vector<FLWordView> &words);
+const char *engineName(FLEngine engine);
+void benchmarkCorpus(FLBenchCorpus *corpus);
+void benchmarkAdversarial(size_t repeatCount, bool useCache);
+int main(int argc, char* argv[]);
+
+// -----------------------------------------------------------------
+
+// runBenchmark()
+// Requires:  std::string reference, size_t, std::function<void()>
+// Returns:   None
+// Runs the body (one iteration over wordsPerIteration words) until the timed loop
+// takes kBenchMinSeconds, and prints the time per word and the words per second.
+// Benchmarks whose name does not contain kBenchFilter are skipped.
+void runBenchmark(const std::string &name, size_t wordsPerIteration, std::function<void()> body) {
+  if(name.find(kBenchFilter) == std::string::npos) return;
+  body();
+  unsigned long iterations = 1;
+  double elapsedSeconds;
+  while(true) {
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    for(unsigned long i = 0; i < iterations; i++)
+      body();
+    elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if(elapsedSeconds >= kBenchMinSeconds || iterations >= (1ul << 30)) break;
+    iterations *= 2;
+  }
+  double words = (double)iterations * std::max(wordsPerIteration, (size_t)1);
+  printf("%-56s %12.1f %13.0f %11lu\n", name.c_str(), elapsedSeconds * 1e9 / words,
+	 words / elapsedSeconds, iterations);
+  fflush(stdout);
+}
+
+// readCorpus()
+// Requires:  FLBenchCorpus *, std::string reference, std::string reference
+// Returns:   None
+// Reads the raw lines of the file into the corpus.  Failure to open the file
+// causes an immediate exit.
+void readCorpus(FLBenchCorpus *corpus, const std::string &name, const std::string &fileName) {
+  std::ifstream fileStream(fileName);
+  if(!fileStream.good()) {
+    printf("ERROR:  Couldn't open file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+  corpus->name = name;
+  corpus->fileName = fileName;
+  corpus->lines.clear();
+  corpus->text.clear();
+  for(std::string line; std::getline(fileStream, line);) {
+    corpus->lines.push_back(line);
+    corpus->text += line;
+    corpus->text += '\n';
+  }
+}
+
+// writeTempCorpus()
+// Requires:  const std::vector<std::string> reference
+// Returns:   std::string
+// Writes the words, one per line, to a new temporary file and returns its name.
+// The caller unlinks the file.
+std::string writeTempCorpus(const std::vector<std::string> &words) {
+  char fileName[] = "/tmp/benchFindLongestXXXXXX";
+  int fileDescriptor = mkstemp(fileName);
+  FILE *file = (fileDescriptor < 0) ? NULL : fdopen(fileDescriptor, "w");
+  if(file == NULL) {
+    printf("ERROR:  Couldn't create a temporary corpus file.\n");
+    exit(1);
+  }
+  for(size_t i = 0; i < words.size(); i++)
+    fprintf(file, "%s\n", words[i].c_str());
+  fclose(file);
+  return fileName;
+}
+
+// makeSyntheticWords()
+// Requires:  std::vector<std::string> reference, size_t, size_t
+// Returns:   None
+// Fills the vector with baseCount random lower case words of 2 to 9 letters and
+// compoundCount concatenations of 2 to 4 of them, sorted and without duplicates.
+// The generator has a fixed seed, so every run gets the same words.
+void makeSyntheticWords(std::vector<std::string> &words, size_t baseCount, size_t compoundCount) {
+  std::mt19937 generator(20131111);
+  std::vector<std::string> baseWords;
+  for(size_t i = 0; i < baseCount; i++) {
+    std::string word(2 + generator() % 8, 'a');
+    for(size_t j = 0; j < word.length(); j++)
+      word[j] = 'a' + generator() % 26;
+    baseWords.push_back(word);
+  }
+  words.assign(baseWords.begin(), baseWords.end());
+  for(size_t i = 0; i < compoundCount; i++) {
+    std::string word;
+    for(size_t parts = 2 + generator() % 3; parts > 0; parts--)
+      word += baseWords[generator() % baseCount];
+    words.push_back(word);
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+}
+
+// loadDictionary()
+// Requires:  FLBenchDictionary *, std::string
+// Returns:   None
+// Loads the file with hashStringFile() and replaces the flat set with the trie or
+// string set for kEngine and kStore (or the double array or DAWG of those engines), and
+// builds the automaton of the ac engine, the Bloom filter of kBloomBitsPerKey, and the
+// length masks, as main() does.
+void loadDictionary(FLBenchDictionary *dictionary, std::string fileName) {
+  hashStringFile(fileName, &dictionary->sizeHash, &dictionary->flatSet, &dictionary->wordStorage);
+  dictionary->trie = NULL;
+  dictionary->automaton = NULL;
+  dictionary->doubleArray = NULL;
+  dictionary->dawg = NULL;
+  dictionary->bloomFilter = NULL;
+  dictionary->stringSet = NULL;
+  dictionary->wordCount = dictionary->wordStorage->wordCount;
+  dictionary->maxWordLength = longestWordLength(dictionary->sizeHash);
+  if(kEngine == kEngineTrie)
+    dictionary->trie = buildTrieFromWords(dictionary->wordStorage);
+  else if(kEngine == kEngineDoubleArray)
+    dictionary->doubleArray = buildDoubleArrayFromWords(dictionary->wordStorage);
+  else if(kEngine == kEngineDawg)
+    dictionary->dawg = buildDawgFromWords(dictionary->wordStorage);
+  else if(kStore == kStoreSTL)
+    dictionary->stringSet = buildStringSetFromWords(dictionary->wordStorage);
+  if(kEngine == kEngineAC)
+    dictionary->automaton = buildAutomatonFromWords(dictionary->wordStorage);
+  if(kBloomBitsPerKey > 0 && (kEngine == kEngineHash || kEngine == kEngineDP))
+    dictionary->bloomFilter = buildBloomFilterFromWords(dictionary->wordStorage, kBloomBitsPerKey);
+  dictionary->lengthMasks = buildLengthMasks(dictionary->sizeHash, dictionary->wordStorage);
+  if(dictionary->trie != NULL || dictionary->doubleArray != NULL || dictionary->dawg != NULL ||
+     dictionary->stringSet != NULL) {
+    delete dictionary->flatSet;
+    dictionary->flatSet = NULL;
+  }
+}
+
+// deleteDictionary()
+// Requires:  FLBenchDictionary *
+// Returns:   None
+// Deletes the structures built by loadDictionary().
+void deleteDictionary(FLBenchDictionary *dictionary) {
+  delete dictionary->trie;
+  delete dictionary->automaton;
+  delete dictionary->doubleArray;
+  delete dictionary->dawg;
+  delete dictionary->bloomFilter;
+  delete dictionary->lengthMasks;
+  delete dictionary->flatSet;
+  delete dictionary->stringSet;
+  delete dictionary->sizeHash;
+  deleteWordStorage(dictionary->wordStorage);
+}
+
+// selectWords()
+// Requires:  FLBenchDictionary *, size_t, size_t, size_t, std::vector<FLWordView> reference
+// Returns:   None
+// Collects up to maxWords words with lengths in [minLength, maxLength], shortest
+// lengths first and in list order within a length.
+void selectWords(FLBenchDictionary *dictionary, size_t minLength, size_t maxLength, size_t maxWords,
+		 std::vector<FLWordView> &words) {
+  words.clear();
+  for(size_t length = minLength; length <= std::min(maxLength, dictionary->maxWordLength); length++) {
+    auto sizeHashIter = dictionary->sizeHash->find(length);
+    if(sizeHashIter == dictionary->sizeHash->end()) continue;
+    std::vector<uint32_t> &wordList = sizeHashIter->second;
+    for(size_t i = 0; i < wordList.size() && words.size() < maxWords; i++)
+      words.push_back(storedWord(dictionary->wordStorage, wordList[i]));
+  }
+}
+
+// engineName()
+// Requires:  FLEngine
+// Returns:   const char *
+// Returns the --engine name of the engine.
+const char *engineName(FLEngine engine) {
+  if(engine == kEngineTrie) return "trie";
+  if(engine == kEngineDP) return "dp";
+  if(engine == kEngineAC) return "ac";
+  if(engine == kEngineDoubleArray) return "dat";
+  if(engine == kEngineDawg) return "dawg";
+  return "hash";
+}
+
+// benchmarkCorpus()
+// Requires:  FLBenchCorpus *
+// Returns:   None
+// Runs the cleaning, loading, per word, and full search benchmarks on the corpus,
+// the last two for each engine.
+void benchmarkCorpus(FLBenchCorpus *corpus) {
+  size_t lineCount = corpus->lines.size();
+  runBenchmark("cleanWord/" + corpus->name, lineCount, [corpus]() {
+      for(size_t i = 0; i < corpus->lines.size(); i++) {
+	std::string line = corpus->lines[i];
+	cleanWord(line);
+	gBenchSink += line.length();
+      }
+    });
+
+  FLIngestKernel kernels[] = { kIngestScalar, kIngestSSE2, kIngestAVX2 };
+  FLIngestKernel selectedKernel = kIngest;
+  std::vector<char> scratch(corpus->text.size());
+  for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    if(!selectIngestKernel(kernels[k])) continue;
+    runBenchmark("ingest/" + std::string(kIngestNames[kernels[k]]) + "/" + corpus->name, lineCount,
+		 [corpus, &scratch]() {
+		   memcpy(scratch.data(), corpus->text.data(), scratch.size());
+		   char *lineStart = scratch.data();
+		   char *dataEnd = lineStart + scratch.size();
+		   gLowerInPlace(lineStart, scratch.size());
+		   while(lineStart < dataEnd) {
+		     char *lineEnd = (char *)gFindNewline(lineStart, dataEnd);
+		     char *word = lineStart;
+		     gBenchSink += trimLineInPlace(word, lineEnd - lineStart);
+		     lineStart = lineEnd + 1;
+		   }
+		 });
+  }
+  selectIngestKernel(selectedKernel);
+
+  runBenchmark("hashStringFile/" + corpus->name, lineCount, [corpus]() {
+      FLLengthMap *sizeHash;
+      FLFlatSet *flatSet;
+      FLWordStorage *wordStorage;
+      hashStringFile(corpus->fileName, &sizeHash, &flatSet, &wordStorage);
+      gBenchSink += flatSet->count;
+      delete flatSet;
+      delete sizeHash;
+      deleteWordStorage(wordStorage);
+    });
+
+  // The parallel loader, with one thread per hardware thread.
+  int threadCount = std::max(2u, std::thread::hardware_concurrency());
+  kThreadCount = threadCount;
+  runBenchmark("hashStringFile/j" + std::to_string(threadCount) + "/" + corpus->name, lineCount, [corpus]() {
+      FLLengthMap *sizeHash;
+      FLFlatSet *flatSet;
+      FLWordStorage *wordStorage;
+      hashStringFile(corpus->fileName, &sizeHash, &flatSet, &wordStorage);
+      gBenchSink += flatSet->count;
+      delete flatSet;
+      delete sizeHash;
+      deleteWordStorage(wordStorage);
+    });
+  kThreadCount = 1;
+
+  FLEngine engines[] = { kEngineHash, kEngineTrie, kEngineDP, kEngineAC, kEngineDoubleArray, kEngineDawg };
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+    kEngine = engines[e];
+    std::string engine = engineName(kEngine);
+    FLBenchDictionary dictionary;
+    loadDictionary(&dictionary, corpus->fileName);
+
+    // Per word checks, without a cache, so each check does its full work every iteration.
+    FLSuffixCache noCache;
+    initSuffixCache(&noCache, 0, dictionary.wordCount);
+    FLSearchContext context;
+    initSearchContext(&context, dictionary.wordStorage, dictionary.stringSet, dictionary.flatSet, dictionary.trie,
+		      dictionary.automaton, dictionary.doubleArray, dictionary.dawg,
+		      dictionary.bloomFilter, dictionary.lengthMasks, &noCache, dictionary.maxWordLength);
+    const char *kindNames[] = { "short", "long" };
+    size_t kindLengths[][2] = { { 1, 6 }, { 20, SIZE_MAX } };
+    for(size_t k = 0; k < 2; k++) {
+      std::vector<FLWordView> words;
+      selectWords(&dictionary, kindLengths[k][0], kindLengths[k][1], 4096, words);
+      if(words.empty()) continue;
+      runBenchmark("checkWord/" + engine + "/" + kindNames[k] + "/" + corpus->name, words.size(),
+		   [&words, &context]() {
+		     for(size_t i = 0; i < words.size(); i++)
+		       gBenchSink += checkWord(words[i], &context);
+		   });
+    }
+
+    runBenchmark("findLongestWordsOfWords/" + engine + "/" + corpus->name, dictionary.wordCount,
+		 [&dictionary]() {
+		   FLSuffixCache suffixCache;
+		   initSuffixCache(&suffixCache, kSuffixCacheMB << 20, dictionary.wordCount);
+		   FLSearchContext searchContext;
+		   initSearchContext(&searchContext, dictionary.wordStorage, dictionary.stringSet, dictionary.flatSet, dictionary.trie,
+				     dictionary.automaton, dictionary.doubleArray, dictionary.dawg,
+				     dictionary.bloomFilter, dictionary.lengthMasks, &suffixCache, dictionary.maxWordLength);
+		   std::vector<std::string> topWords;
+		   gBenchSink += findLongestWordsOfWords(&searchContext, dictionary.sizeHash, topWords);
+		 });
+    deleteDictionary(&dictionary);
+  }
+
+  kEngine = kEngineHash;
+  runBenchmark("endToEnd/" + corpus->name, lineCount, [corpus]() {
+      FLBenchDictionary dictionary;
+      loadDictionary(&dictionary, corpus->fileName);
+      FLSuffixCache suffixCache;
+      initSuffixCache(&suffixCache, kSuffixCacheMB << 20, dictionary.wordCount);
+      FLSearchContext searchContext;
+      initSearchContext(&searchContext, dictionary.wordStorage, dictionary.stringSet, dictionary.flatSet, dictionary.trie,
+			dictionary.automaton, dictionary.doubleArray, dictionary.dawg,
+			dictionary.bloomFilter, dictionary.lengthMasks, &suffixCache, dictionary.maxWordLength);
+      std::vector<std::string> topWords;
+      gBenchSink += findLongestWordsOfWords(&searchContext, dictionary.sizeHash, topWords);
+      deleteDictionary(&dictionary);
+    });
+}
+
+// benchmarkAdversarial()
+// Requires:  size_t, bool
+// Returns:   None
+// Times the check of "a" * n + "b" against the words "a" .. "a" * n with each engine.
+// Without the cache, the greedy engines backtrack through every split, so n stays
+// small; with the cache, a fresh cache is made for every check.
+void benchmarkAdversarial(size_t repeatCount, bool useCache) {
+  std::vector<std::string> words;
+  for(size_t i = 1; i <= repeatCount; i++)
+    words.push_back(std::string(i, 'a'));
+  words.push_back(std::string(repeatCount, 'a') + "b");
+  std::string fileName = writeTempCorpus(words);
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), "/adversarial%lu/%s", (unsigned long)repeatCount,
+	   useCache ? "cache" : "nocache");
+
+  FLEngine engines[] = { kEngineHash, kEngineTrie, kEngineDP, kEngineAC, kEngineDoubleArray, kEngineDawg };
+  for(size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+    kEngine = engines[e];
+    FLBenchDictionary dictionary;
+    loadDictionary(&dictionary, fileName);
+    FLWordView word = storedWord(dictionary.wordStorage, (*dictionary.sizeHash)[repeatCount + 1][0]);
+    runBenchmark(std::string("checkWord/") + engineName(kEngine) + suffix, 1,
+		 [&dictionary, &word, useCache]() {
+		   FLSuffixCache suffixCache;
+		   initSuffixCache(&suffixCache, useCache ? (kSuffixCacheMB << 20) : 0, dictionary.wordCount);
+		   FLSearchContext context;
+		   initSearchContext(&context, dictionary.wordStorage, dictionary.stringSet, dictionary.flatSet, dictionary.trie,
+				     dictionary.automaton, dictionary.doubleArray, dictionary.dawg,
+				     dictionary.bloomFilter, dictionary.lengthMasks, &suffixCache, dictionary.maxWordLength);
+		   gBenchSink += checkWord(word, &context);
+		 });
+    deleteDictionary(&dictionary);
+  }
+  kEngine = kEngineHash;
+  unlink(fileName.c_str());
+}
+
+// main()
+// Requires:  int, char*
+// Returns:   int
+// Parses the driver options and corpus file names, then runs the benchmarks on
+// each corpus, on the synthetic corpus, and on the adversarial words.
+int main(int argc, char* argv[]) {
+  std::vector<std::string> fileNames;
+  for(int carg = 1; carg < argc; carg++) {
+    std::string argstr = argv[carg];
+    if(argstr.compare(0, 9, "--filter=") == 0)
+      kBenchFilter = argstr.substr(9);
+    else if(argstr.compare(0, 11, "--min-time=") == 0)
+      kBenchMinSeconds = atof(argstr.c_str() + 11);
+    else if(strncmp(argv[carg], "-", 1) == 0) {
+      printf("Usage: %s [--filter=TEXT] [--min-time=SECONDS] [word_input_text_file ...]\n", argv[0]);
+      exit(1);
+    } else
+      fileNames.push_back(argstr);
+  }
+  if(fileNames.empty())
+    fileNames.push_back("wordsforproblem.txt");
+  selectIngestKernel(kIngestAuto);
+
+  printf("%-56s %12s %13s %11s\n", "Benchmark", "ns/word", "words/sec", "iterations");
+  for(size_t i = 0; i < fileNames.size(); i++) {
+    FLBenchCorpus corpus;
+    std::string name = fileNames[i].substr(fileNames[i].find_last_of('/') + 1);
+    readCorpus(&corpus, name, fileNames[i]);
+    benchmarkCorpus(&corpus);
+  }
+
+  std::vector<std::string> syntheticWords;
+  makeSyntheticWords(syntheticWords, 20000, 80000);
+  FLBenchCorpus synthetic;
+  readCorpus(&synthetic, "synthetic", writeTempCorpus(syntheticWords));
+  benchmarkCorpus(&synthetic);
+  unlink(synthetic.fileName.c_str());
+
+  benchmarkAdversarial(18, false);
+  benchmarkAdversarial(30, true);
+  return 0;
+}
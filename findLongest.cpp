@@ -4,18 +4,41 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
 #include <string>
 #include <algorithm>
 #include <iostream>
-#include <fstream>
 #include <utility>
 #include <unordered_map>
 #include <unordered_set>
+#include <set>
 #include <vector>
 #include <iterator>
+#include <chrono>
+#include <new>
+#include <atomic>
+#include <thread>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FL_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
 
 // Compilation caveats:
 //   Requires C++11 extensions, for use of 'auto' type specifier to simplify iterator declaration.
+//   Requires thread support (-pthread) for the parallel search (-j).
+//   Defining FL_NO_MAIN leaves out main(), so benchFindLongest.cpp can include this file.
 
 // Notes on the problem:
 // (1) The input file may have extra control characters, whitespace, empty lines, and mixed case.
@@ -25,6 +48,23 @@
 // (4) The given input file is already sorted, except for extra blank lines.  If the input file
 //     were not already sorted, then we could sort it first, adding an average O(n log n) operation.
 //     (Implemented as a command line option.)
+// (5) Large lists (multiple GB) can be loaded with --mmap:  the file is mapped privately
+//     and cleaned in place, and the word table holds the offsets of the words in the
+//     mapping instead of copies.  Only lines that need lower casing write to (and copy) their
+//     page, so loading is bound by page faults instead of one string allocation per line.
+// (6) Without --mmap, the cleaned words are stored back to back in one character arena.
+//     Each word is interned once:  an 8 byte (offset, length) entry in the word table, one
+//     4 byte index in its length bucket, and an 8 byte slot (hash tag, index) in the open
+//     addressing set, instead of a string, a set node, and a view per word.
+// (7) Both loaders find line ends and clean lines with the ingest kernels (--simd):  SSE2
+//     or AVX2 compares 16 or 32 bytes at a time to find newlines, skip leading spaces, and
+//     find upper case ASCII letters, chosen at run time from the CPU, with the scalar
+//     functions as the fallback.  Without --mmap, the file is read in blocks into one
+//     buffer and cleaned there, instead of one std::string per line.
+// (8) With -j N, loading is parallel too (loadTextParallel()):  the threads clean and hash
+//     newline aligned chunks of the text, then build the set in disjoint slot ranges, so
+//     the words, their order, and the length buckets are the same as a sequential load
+//     (and the set is equivalent:  same members and lookups, not the same slot layout).
 //
 // Steps to find longest words made of other words:
 // (1) Read words in separate lines, clean the words, and add the words to a (hashed) set.
@@ -62,13 +102,18 @@
 //       Try a match with the remaining characters, if none, remove characters until we match
 //       Try a match, ... and so on ...
 
-// Time optimization ideas that would require much more space (not implemented):
+// Time optimization ideas that would require much more space (implemented as FLSuffixCache):
 //   (1) Store the results of completely failed partial words in another set,
 //       to avoid unnecessarily checking partial words with no subset matches.
 //   (2) Store successful words already found for a partial word in another hash
 //       (using pointers).
+//   Both results live in one hash keyed by the remaining substring, since only the
+//   remaining (suffix) substrings are ever passed to the recursive call.  The cache is
+//   shared by all words in a run, so common endings ("ness", "ations") are tested once.
+//   Memory is bounded by a byte budget (--cache-mb); once full, new results are dropped
+//   but lookups continue, so a full cache never changes the answer, only the speed.
 
-// A different and possibly better alternative (not implemented):
+// A different and possibly better alternative (implemented as --engine=trie):
 // Build a trie, suffix tree, or array; mark end of words on a path as it is built.
 //  A custom trie would allow us to find the ends of words more easily,
 //  testing each node for an "end of word" marker.  The greedy method
@@ -91,6 +136,58 @@
 //   last-1 "end of word" marker at exception - rest is ally, ally is in string set
 // We would not have to test "exceptionall"/"y", "exceptional"/"ly", or "exceptiona","lly"
 // The average number of lookups per word would fall.
+//
+// The trie (FLTrie) is a vector of nodes with first-child/next-sibling links, built
+// from the string set after loading.  A "lookup" for the trie engine is one walk from
+// a start position, which finds every word boundary from that position at once.
+// On wordsforproblem.txt (with the suffix cache), the hash engine makes 9.81 set
+// lookups per word tested; the trie engine makes 1.43 walks per word (10.9 node steps).
+
+// Bottom-up alternative with a guaranteed bound (implemented as --engine=dp):
+// Both greedy engines backtrack, and without the suffix cache a word like "aaaa...ab"
+// against (a, aa, aaa, ...) takes exponential time.  The word-break dynamic program
+// marks reachable split positions in a per-word bitset, left to right:
+//   reachable[0] is set; for each reachable position i, probe the substrings starting
+//   at i with lengths 1 .. min(longest word length, L - i), and mark i + length
+//   reachable on a match.  The full word is never probed at position 0.
+//   The word is made of other words when position L becomes reachable.
+// Each position is expanded at most once, so a word of length L makes at most
+// L * min(L - 1, longest word length) set lookups, regardless of the dictionary.
+// It makes more lookups than the greedy engines on typical words, but the bound
+// is what --alert-us latency alerts can be checked against.
+
+// Multi-pattern alternative (implemented as --engine=ac):
+// An Aho-Corasick automaton over the dictionary reports every dictionary word ending
+// at each position of a word in one left-to-right scan, instead of one probe per
+// (start, length) pair.  Because a word ending at position j starts before j, the
+// word-break reachability can be filled in during the same scan:
+//   reachable[0] is set; at each position j, for each dictionary word of length len
+//   ending at j (the current state and its output links), reachable[j] is set if
+//   reachable[j - len] is.  The full word is never used at position 0.
+// A scan costs O(L) transitions (amortized over the failure links) plus the number of
+// word occurrences in the word, however long the longest dictionary word is.
+
+// Compact trie alternative (implemented as --engine=dat):
+// The trie engine's nodes take 12 bytes each, with a sibling list to search at every
+// step.  A double-array trie stores each node as one 8 byte unit (base, check) in a flat
+// array:  the child of node s for letter code c is unit t = base[s] + c, which exists if
+// check[t] == s, so every step is one array read and one compare.  The words are sorted
+// and the array is filled depth first, placing the children of each node at the first
+// base where all of their units are free.  The array holds no pointers, so --compile
+// writes it into the snapshot, and a mapped snapshot uses it in place, without building.
+// The engine is the trie engine's greedy search with double-array walks.
+
+// Shared-suffix alternative (implemented as --engine=dawg):
+// A trie shares the prefixes of the words, but English words also share their endings
+// ("-ing", "-ness", "-ations"), which every trie path repeats.  The minimal acyclic
+// automaton (DAWG) of the words merges equal subtrees as well, so each distinct ending
+// is stored once.  It is built incrementally from the sorted words (Daciuk, Mihov,
+// Watson, and Watson):  the path of the last word added is the only part still under
+// construction, and when the next word leaves it, the states below the common prefix
+// are final; each is replaced by an equal state from a register of the finished
+// states, if there is one, or added to it.  The automaton is minimal once the last
+// path is finished, and walking it finds the same word ends as a trie walk, so the
+// engine is the trie engine's greedy search with DAWG walks.
 
 // -----------------------------------------------------------------
 
@@ -98,32 +195,762 @@
 // Sort will add an average O(n log n) operation.
 static bool kDoDebug = false;
 static bool kDoPreSort = false;
+// Byte budget for the suffix cache, in megabytes; 0 disables the cache.
+static size_t kSuffixCacheMB = 64;
+
+// Compound checking engines, selected with --engine=<name>.
+enum FLEngine { kEngineHash, kEngineTrie, kEngineDP, kEngineAC, kEngineDoubleArray, kEngineDawg };
+static FLEngine kEngine = kEngineHash;
+// Words taking longer than this many microseconds to check are reported; 0 disables timing.
+static long kAlertMicros = 0;
+// Number of search threads (-j N); 1 runs the original sequential loop.
+static int kThreadCount = 1;
+// Words claimed at a time from the shared cursor by each search thread.
+static const size_t kSearchChunkWords = 256;
+// Number of longest compounds to report (--top K; the default reports first and second),
+// and whether to count all compounds.  Without the count (--no-count), the search stops
+// as soon as the K longest compounds are known.
+static size_t kTopCount = 2;
+static bool kDoTopList = false;
+static bool kDoCount = true;
+// Build the DAWG of --engine=dawg while loading the words, if they come sorted (--stream).
+static bool kDoStream = false;
+// Print per-phase times and search counters as "stats.<name>=<value>" lines (--stats).
+static bool kDoStats = false;
+// Print the segmentation DAG and decomposition count of every compound (--segments).
+static bool kDoSegments = false;
+
+// Non-owning view of a cleaned word (not null terminated).  The characters belong to
+// an FLWordStorage object, which must outlive the set and length map holding the views.
+struct FLWordView {
+  const char *data;
+  size_t length;
+};
+
+// Polynomial hash of a run of characters, shared by FLWordViewHash, FLFlatSet, and the
+// suffix cache:  poly(c[0..n)) = sum of (c[i] + 1) * base^(n - 1 - i), modulo 2^64,
+// passed through mixHash() so the low bits (used for slots) depend on every character.
+// Because the hash is polynomial, the checkers compute the prefix hashes of a word once
+// (O(L)) and get the hash of any substring from two of them in O(1) (substringHash()),
+// instead of rehashing every probed substring from scratch (O(L^2) per word).
+// Equal hashes are always verified by comparing characters, so collisions only cost time.
+static const uint64_t kHashBase = 0x9e3779b97f4a7c15ULL;
+
+// Final avalanche step applied to a polynomial hash.
+static inline uint64_t mixHash(uint64_t hash) {
+  hash ^= hash >> 32;
+  hash *= 0xd6e8feb86659fd93ULL;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+// Appends one character to a polynomial hash (one Horner step, wrapping modulo 2^64).
+static inline uint64_t extendHash(uint64_t poly, char c) {
+  return poly * kHashBase + (unsigned char)c + 1;
+}
+
+static inline uint64_t hashWordChars(const char *data, size_t length) {
+  uint64_t poly = 0;
+  for(size_t i = 0; i < length; i++)
+    poly = extendHash(poly, data[i]);
+  return mixHash(poly);
+}
+
+// Hash and equality of the viewed characters, for use as unordered_set functors.
+struct FLWordViewHash {
+  size_t operator()(const FLWordView &w) const {
+    return (size_t)hashWordChars(w.data, w.length);
+  }
+};
+struct FLWordViewEqual {
+  bool operator()(const FLWordView &a, const FLWordView &b) const {
+    return (a.length == b.length) && (memcmp(a.data, b.data, a.length) == 0);
+  }
+};
+
+// Offset and length of a stored word, packed into 8 bytes:  the offset from the start
+// of the word storage in the upper 40 bits, and the length in the lower 24 bits.
+typedef uint64_t FLWordEntry;
+static const size_t kMaxWordChars = (1 << 24) - 1;
+
+// Owner of the characters of the loaded words.  hashStringFile() appends each new cleaned
+// word to the arena (reserved for the file size, so it does not move while loading);
+// mapStringFile() leaves the words in the private file mapping (as does hashStringFile()
+// with -j, in an anonymous mapping it reads the file into), and mapSnapshotFile()
+// in the mapped snapshot.  entries points to the table of entries of the wordCount
+// distinct words, in load order:  words.data() while loading text, or the table in the
+// snapshot.  The length map, the flat set, and the search refer to a word by its index
+// in the table.
+struct FLWordStorage {
+  std::vector<char> arena;
+  std::vector<FLWordEntry> words;
+  char *mappedData;
+  size_t mappedLength;
+  const FLWordEntry *entries;
+  size_t wordCount;
+};
+
+// Start of the stored characters, and a view of the word at an index of the table.
+static inline const char *wordStorageBase(const FLWordStorage *wordStorage) {
+  return wordStorage->mappedData ? wordStorage->mappedData : wordStorage->arena.data();
+}
+static inline FLWordView storedWord(const FLWordStorage *wordStorage, uint32_t wordIndex) {
+  FLWordEntry entry = wordStorage->entries[wordIndex];
+  return FLWordView{ wordStorageBase(wordStorage) + (entry >> 24), (size_t)(entry & kMaxWordChars) };
+}
+
+// Counters kept by the loaders.  Lines that clean to an empty word are skipped;
+// words that clean to a word already in the set are dropped (and counted).
+// cleanSeconds is only measured with --stats, since it times every line.
+// With --stream, firstUnsortedLine is the line of the first word out of order (0 if
+// none), and sortedInput is set once the stream has taken every word in order.
+struct FLLoadStats {
+  unsigned long linesRead;
+  unsigned long wordsLoaded;
+  unsigned long duplicatesDropped;
+  double cleanSeconds;
+  unsigned long firstUnsortedLine;
+  bool sortedInput;
+};
 
 // Typedefs to simplify multiple usage of these template types.
-typedef std::unordered_map<size_t, std::vector<std::string *> > FLLengthMap;
-typedef std::unordered_set<std::string> FLStringSet;
-typedef std::__hash_const_iterator<const std::__hash_node<std::string, void *> *> FLSetIterator;
+// The length map holds the word table indices of the words of each length.
+typedef std::unordered_map<size_t, std::vector<uint32_t> > FLLengthMap;
+typedef std::unordered_set<FLWordView, FLWordViewHash, FLWordViewEqual> FLStringSet;
+
+// Orders word table indices by the characters of their words (see sizeHashSortFunction()).
+struct FLWordIndexLess {
+  const FLWordStorage *wordStorage;
+  bool operator()(uint32_t a, uint32_t b) const;
+};
+
+// Global option to load the input file through a private memory mapping (mapStringFile()).
+static bool kDoMmap = false;
+// Output file for --compile:  the loaded dictionary is written as a snapshot instead of searched.
+static std::string kCompileName = "";
+// Unix domain socket path for --serve:  the loaded dictionary answers queries instead of being searched.
+static std::string kServePath = "";
+
+// Open addressing set of the stored words, used to drop duplicates while loading and
+// for lookups by the checkers (the default store).
+// FLStringSet is node based:  one allocation per word and a pointer chase per lookup.
+// FLFlatSet keeps a power of two array of 8 byte slots with linear probing and a load
+// factor <= 1/2.  Each slot stores the upper 32 bits of the word hash and the word table
+// index + 1; 0 marks an empty slot.  A probe compares the stored hash before reading
+// the table entry and the characters, so a miss usually costs one or two slots in a
+// single cache line.
+struct FLFlatSlot {
+  uint32_t hashTag;
+  uint32_t wordNumber;
+};
+// slotTable points to the slots:  slots.data(), or the slot array in a mapped snapshot.
+struct FLFlatSet {
+  const FLWordStorage *wordStorage;
+  std::vector<FLFlatSlot> slots;
+  const FLFlatSlot *slotTable;
+  size_t mask;
+  size_t count;
+};
+
+// Precompiled dictionary snapshot (--compile), loaded by mapping it read only.
+// The file is the header followed by 8 byte aligned sections, with offsets from the
+// start of the file:  the characters of the words, the word table (FLWordEntry, with
+// offsets from the start of the file), the flat set slots, the length buckets, and the
+// word table indices of the buckets back to back, then (if compiled with --engine=dat,
+// else doubleArrayUnitCount is 0) the 256 letter codes and the units of the double
+// array, 8 byte aligned.  A snapshot is only loaded if the
+// magic, version, byte order, and hash check (the hash of kSnapshotHashCheckWord, which
+// changes if the hash function does) match those of the running program.
+static const char kSnapshotMagic[8] = { '\x89', 'F', 'L', 'D', '\r', '\n', '\x1a', '\n' };
+static const uint32_t kSnapshotVersion = 2;
+static const uint32_t kSnapshotByteOrder = 0x01020304;
+static const char *kSnapshotHashCheckWord = "findlongest";
+struct FLSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t hashCheck;
+  uint64_t fileLength;
+  uint64_t wordCount;
+  uint64_t maxWordLength;
+  uint64_t charsOffset;
+  uint64_t charsLength;
+  uint64_t entriesOffset;
+  uint64_t slotsOffset;
+  uint64_t slotCount;
+  uint64_t bucketsOffset;
+  uint64_t bucketCount;
+  uint64_t indicesOffset;
+  uint64_t doubleArrayOffset;
+  uint64_t doubleArrayUnitCount;
+};
+// Words of one length:  count table indices starting at firstIndex in the indices section.
+struct FLSnapshotBucket {
+  uint64_t length;
+  uint64_t firstIndex;
+  uint64_t count;
+};
+
+// Lookup stores, selected with --store=<name>.
+enum FLStore { kStoreFlat, kStoreSTL };
+static FLStore kStore = kStoreFlat;
+
+// Blocked Bloom filter of the stored words (--bloom-bits=N, N bits per word; 0 builds
+// none), checked by dictionaryContains() before the store, so that most of the misses
+// of the greedy search (a prefix shrinking one letter at a time) are answered without
+// reading the store.  A word sets probeCount bits of one 64 byte block (one cache line)
+// picked by the upper half of its hash:  probe i sets bit (a + i * b) mod 512 of the
+// block, with a and b (odd) the halves of the remixed hash.  blocks points to the
+// first 64 byte boundary in words.
+static size_t kBloomBitsPerKey = 0;
+static const size_t kBloomBlockWords = 8;
+static const unsigned kBloomMaxProbes = 16;
+struct FLBloomFilter {
+  std::vector<uint64_t> words;
+  uint64_t *blocks;
+  size_t blockCount;
+  unsigned probeCount;
+};
+
+// Lengths of the stored words, so that dictionaryContains() skips the lengths no word
+// has (lengthMayMatch()).  Bit l of lengths[l / 64] is set if a word has length l, and
+// bit l of firstLetterLengths[c] if a word of length l < 64 starts with the byte c.
+// minLength (at least 1) and maxLength bound the lengths.  The server's DEL leaves
+// the bits of a deleted word, so the masks may hold lengths no word has any more.
+struct FLLengthMasks {
+  std::vector<uint64_t> lengths;
+  uint64_t firstLetterLengths[256];
+  size_t minLength;
+  size_t maxLength;
+};
+
+// Ingest kernels, selected with --simd=<name>; auto picks the widest the CPU supports.
+// selectIngestKernel() points the kernel functions below at the chosen versions.
+enum FLIngestKernel { kIngestAuto, kIngestScalar, kIngestSSE2, kIngestAVX2 };
+static const char *kIngestNames[] = { "auto", "scalar", "sse2", "avx2" };
+static FLIngestKernel kIngest = kIngestScalar;
+// Bytes read at a time by hashStringFile() (the buffer grows for longer lines).
+static const size_t kIngestBlockBytes = 1 << 20;
+
+// Per-run memo cache of remaining substrings tested by the checkers.
+// Keys are views of suffixes of the words being checked, which stay in the word
+// storage for the whole run, so no characters are copied.  The result records
+// whether the suffix can be built from words in the set.
+// The slot array (linear probing, at most half full) is sized once from the byte
+// budget and the number of words, so storing a result never allocates; results
+// that arrive once maxEntries is reached are dropped.
+struct FLSuffixSlot {
+  const char *data;
+  uint32_t length;
+  uint32_t result;
+};
+struct FLSuffixCache {
+  std::vector<FLSuffixSlot> slots;
+  size_t mask;
+  size_t maxEntries;
+  size_t entries;
+  size_t bytes;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long dropped;
+};
+
+// Trie node with first-child/next-sibling links (indices into the FLTrie vector, -1 if none).
+// Node 0 is the root.  endOfWord marks the last letter of a word in the set.
+struct FLTrieNode {
+  int firstChild;
+  int nextSibling;
+  char letter;
+  bool endOfWord;
+};
+typedef std::vector<FLTrieNode> FLTrie;
+
+// Aho-Corasick automaton (--engine=ac), built from the trie of the words.  States are
+// numbered in breadth first order, so the children of a state are the childCount
+// states from firstChild, in increasing letter order, and letters[i] is the letter
+// leading to state i:  scanning the children of a state reads a few adjacent bytes,
+// and no transition targets are stored.  State 0 is the root, whose transitions are
+// also kept in rootNext (0 for letters starting no word).  fail is the state of the
+// longest proper suffix of the state's path that is a path in the trie, output the
+// nearest state on the failure chain ending a word (0 if none), and wordLength the
+// length of the word ending at the state (0 if none).
+struct FLAutomatonState {
+  uint32_t firstChild;
+  uint32_t childCount;
+  uint32_t fail;
+  uint32_t output;
+  uint32_t wordLength;
+};
+struct FLAutomaton {
+  std::vector<FLAutomatonState> states;
+  std::vector<unsigned char> letters;
+  uint32_t rootNext[256];
+};
+
+// Double-array trie (--engine=dat).  Unit 0 is the root.  The child of unit s for
+// letter code c is unit (base of s) + c, if its check is s; kDoubleArrayTerminal in
+// base marks the last letter of a word.  Free units have a check of kDoubleArrayFree.
+// codes maps each byte to its letter code (1 .. the number of distinct letters in the
+// words; 0 for letters in no word).  unitTable points to the units:  units.data(), or
+// the double array section of a mapped snapshot.
+static const uint32_t kDoubleArrayTerminal = 0x80000000u;
+static const uint32_t kDoubleArrayFree = 0xffffffffu;
+struct FLDoubleArrayUnit {
+  uint32_t base;
+  uint32_t check;
+};
+struct FLDoubleArray {
+  std::vector<FLDoubleArrayUnit> units;
+  const FLDoubleArrayUnit *unitTable;
+  size_t unitCount;
+  unsigned char codes[256];
+};
+
+// Minimal acyclic automaton of the words (--engine=dawg).  The arcs of a state are the
+// arcCount (without kDawgFinal) arcs from firstArc, in increasing letter order, with
+// their letters in arcLetters and their target states in arcTargets, so finding an arc
+// scans a few adjacent bytes.  kDawgFinal in arcCount marks a state ending a word.
+// States are numbered as they are finished, after all of their targets, so the root
+// is the last one.
+static const uint32_t kDawgFinal = 0x80000000u;
+static const uint32_t kDawgNoState = 0xffffffffu;
+static const uint64_t kDawgNoSlot = 0xffffffffffffffffULL;
+struct FLDawgState {
+  uint32_t firstArc;
+  uint32_t arcCount;
+};
+struct FLDawg {
+  std::vector<FLDawgState> states;
+  std::vector<unsigned char> arcLetters;
+  std::vector<uint32_t> arcTargets;
+  uint32_t root;
+};
+
+// Incremental construction of a DAWG from words added in increasing order.  path[d]
+// is the unfinished state reached by the first d letters of the last word added; the
+// last arc of each (but the deepest) leads to the next one, whose target is set when
+// it is finished.  pathLength is the number of path states in use (the length of the
+// last word + 1); the path vectors are kept for reuse.  registry is an open addressing
+// table of the finished states, hashed by their arcs and finality:  each slot holds the
+// upper half of the hash of its state (which also picks the slot) above the state
+// number, or kDawgNoSlot if empty, so most mismatches and the growth of the table do
+// not read the states.  At most 2^31 states keep the table within 2^32 slots.
+struct FLDawgPathState {
+  std::vector<unsigned char> letters;
+  std::vector<uint32_t> targets;
+  bool final;
+};
+struct FLDawgBuilder {
+  FLDawg *dawg;
+  std::vector<FLDawgPathState> path;
+  size_t pathLength;
+  std::vector<uint64_t> registry;
+  size_t registered;
+};
+
+// Counters for algorithm analysis, printed in debug mode and with --stats.
+// A lookup is one set probe (hash engine), one walk from a start position (trie engine),
+// or one scan of a word (ac engine, whose transitions count as trie node steps); the
+// double-array and dawg engines count as the trie engine.
+// checkCalls counts calls of the engine's checker, including the recursive ones, and
+// maxCheckDepth is the deepest nesting of them (1 for the dp engine, which does not recurse).
+// lookupHistogram[b] counts the words checked with 2^(b-1) .. 2^b - 1 lookups (b = 0:  none).
+// With a Bloom filter, bloomNegatives counts the lookups it answered, and
+// bloomFalsePositives the words it let through that the store did not hold.
+// lengthSkips counts the lookups the length masks answered (not counted as lookups).
+static const size_t kLookupHistogramBuckets = 24;
+struct FLSearchStats {
+  unsigned long wordsTested;
+  unsigned long lookups;
+  unsigned long hashedChars;
+  unsigned long trieNodeSteps;
+  unsigned long maxLookupsPerWord;
+  unsigned long checkCalls;
+  unsigned long maxCheckDepth;
+  unsigned long alerts;
+  unsigned long allocations;
+  unsigned long bloomNegatives;
+  unsigned long bloomFalsePositives;
+  unsigned long lengthSkips;
+  unsigned long lookupHistogram[kLookupHistogramBuckets];
+};
+
+// Structures used by the compound checker; only those needed by kEngine are set.
+// The scratch vectors are reserved by initSearchContext() and reused for every word,
+// so checking a word does not allocate.  prefixHashes holds the hashes of the prefixes
+// of hashedWord (the word being checked), and hashPowers the powers of the hash base.
+// Each search thread has its own context (and suffix cache); the dictionary structures
+// are shared and read only.
+struct FLSearchContext {
+  const FLWordStorage *wordStorage;
+  FLStringSet *stringSet;
+  FLFlatSet *flatSet;
+  FLTrie *trie;
+  FLAutomaton *automaton;
+  FLDoubleArray *doubleArray;
+  FLDawg *dawg;
+  FLBloomFilter *bloomFilter;
+  FLLengthMasks *lengthMasks;
+  FLSuffixCache *suffixCache;
+  size_t maxWordLength;
+  std::vector<size_t> trieBoundaries;
+  std::vector<unsigned char> dpReachable;
+  const char *hashedWord;
+  std::vector<uint64_t> prefixHashes;
+  std::vector<uint64_t> hashPowers;
+  unsigned long checkDepth;
+  FLSearchStats stats;
+};
+
+// Segmentation of one word (--segments).  An edge (start, end) is a dictionary word at
+// [start, end) of the word; the word itself (0, length) is never an edge.  pathCounts[i]
+// is the number of ways to split the first i characters into words (saturated at
+// UINT64_MAX, with saturated set), and reachesEnd[i] is set if the end of the word can
+// be reached from position i.  edges holds the edges on at least one full split, in
+// increasing (start, end) order.
+struct FLSegmentation {
+  std::vector<uint64_t> pathCounts;
+  std::vector<unsigned char> reachesEnd;
+  std::vector<std::pair<uint32_t, uint32_t> > edges;
+  std::vector<uint32_t> positions;
+  bool saturated;
+};
+
+// State of one search thread in the parallel search.  topIndices holds the (up to
+// kTopCount) smallest positions, in longest-first order, of the compounds it found.
+struct FLSearchWorker {
+  FLSearchContext context;
+  FLSuffixCache suffixCache;
+  std::vector<size_t> topIndices;
+  int countFound;
+};
+
+// Parallel loader (-j N):  one line of the text, with its cleaned word as a word table
+// entry (an offset from the storage base) and the hash of the word.  Once the duplicates
+// are resolved, the hash of each loaded word is replaced by its table index.  A line whose
+// word is too long for an entry keeps its length in hash instead.
+struct FLLoadLine {
+  FLWordEntry entry;
+  uint64_t hash;
+};
+enum FLLoadLineStatus { kLoadLineWord, kLoadLineEmpty, kLoadLineTooLong, kLoadLineDuplicate };
+// Results of probing the slots of the set for the word of a line (probeLoadSlots()).
+enum FLLoadProbe { kLoadProbeInserted, kLoadProbeDuplicate, kLoadProbeOverflow };
+
+// Share of the parallel loader of one thread.  The thread cleans and hashes the lines
+// of a newline aligned chunk of the text, [chunkStart, chunkEnd), into lines and
+// lineStatus; lines are numbered across the threads from firstLine.  rangeLines[r]
+// lists the (chunk relative) lines whose home slot is in the slot range of thread r,
+// and overflowLines the lines (numbered across the threads) whose probe left the slot
+// range of this thread.  The loaded words are numbered across the threads from firstWord.
+struct FLLoadWorker {
+  char *chunkStart;
+  char *chunkEnd;
+  bool readFailed;
+  std::vector<FLLoadLine> lines;
+  std::vector<uint8_t> lineStatus;
+  size_t firstLine;
+  std::vector<std::vector<uint32_t> > rangeLines;
+  std::vector<uint32_t> overflowLines;
+  size_t firstWord;
+};
+
+// State shared by the steps of the parallel loader:  the text (the mapping of the word
+// storage), the file it is read from (hashStringFile() only), the workers, the set being
+// built, and the word table being filled.
+struct FLLoadJob {
+  char *text;
+  size_t textLength;
+  int fileDescriptor;
+  std::vector<FLLoadWorker> workers;
+  FLFlatSet *flatSet;
+  FLWordEntry *entries;
+};
+
+// Query server (--serve):  one client connection.  input holds the bytes received and
+// not yet handled, output the responses not yet sent.  While batchRemaining words of a
+// BATCH request are still expected, their results are collected in batchResults.
+struct FLServeClient {
+  int fileDescriptor;
+  std::string input;
+  std::string output;
+  size_t batchRemaining;
+  std::string batchResults;
+  bool closing;
+};
+
+// Orders the word table indices of compounds as findLongestWordsOfWords() finds them:
+// longest first, then in length bucket order (load order, or by characters with -s).
+struct FLCompoundOrder {
+  const FLWordStorage *wordStorage;
+  bool operator()(uint32_t a, uint32_t b) const;
+};
+typedef std::set<uint32_t, FLCompoundOrder> FLCompoundSet;
+// Query server:  state of each word table index, once the compounds are tracked.
+enum FLServeWordState { kServeWordPlain, kServeWordCompound, kServeWordDeleted };
+
+// Query server state:  the listening socket and its clients, the dictionary and its
+// search context (used for the first scan of the compounds, with the run's suffix
+// cache), and a context for query words and rechecks.  The query words live in the
+// clients' input buffers, so the query context has its own small suffix cache, cleared
+// before each word.  Once a request needs them (TOP, COUNT, ADD, DEL), wordStates and
+// compounds track every compound, and ADD and DEL keep them up to date by rechecking
+// only the words they can affect.  Updates copy a mapped dictionary into the word
+// storage first (storageOwned); removed words keep their table index (and characters).
+struct FLServer {
+  int listenDescriptor;
+  std::string socketPath;
+  std::vector<FLServeClient> clients;
+  FLSearchContext *context;
+  FLLengthMap *sizeHash;
+  FLWordStorage *wordStorage;
+  FLSearchContext queryContext;
+  FLSuffixCache queryCache;
+  std::vector<uint8_t> wordStates;
+  FLCompoundSet compounds;
+  bool storageOwned;
+  size_t deletedWords;
+  unsigned long requests;
+  unsigned long rechecks;
+};
+// Bytes read from a client at a time, output bytes above which a client's requests are
+// no longer read (until it reads its responses), and the longest request line.
+static const size_t kServeReadBytes = 1 << 16;
+static const size_t kServeMaxOutput = 1 << 20;
+static const size_t kServeMaxLine = (1 << 24) + 64;
+// Largest batch size and TOP count accepted.
+static const size_t kServeMaxBatch = 1 << 20;
+static const size_t kServeMaxTop = 1 << 20;
+// Set by SIGINT and SIGTERM to stop the query server.
+static volatile sig_atomic_t gServeStop = 0;
+
+// Count of calls to the global operator new (replaced below) by each thread, so --stats
+// can report how many allocations the search loop made (stats.search_allocations).
+// Per thread, so the search threads count only their own allocations (not the setup
+// of the threads by the main thread).
+static thread_local unsigned long gAllocationCount = 0;
+
+// Run phases timed for --stats.  The clean time is part of the load phase.
+enum FLPhase { kPhaseLoad, kPhaseIndex, kPhaseSort, kPhaseSearch, kPhaseCount };
+static const char *kPhaseNames[kPhaseCount] = { "load", "index", "sort", "search" };
+// Start of a phase; CPU time is for the whole process, so it includes all search threads.
+struct FLPhaseClock {
+  std::chrono::steady_clock::time_point wallStart;
+  double cpuStart;
+};
+// Wall and CPU seconds spent in each phase, and the loader counters.
+static double gPhaseWallSeconds[kPhaseCount];
+static double gPhaseCpuSeconds[kPhaseCount];
+static FLLoadStats gLoadStats;
+// DAWG under construction by the loaders with --stream (NULL otherwise, or once a word
+// came out of order).
+static FLDawgBuilder *gDawgStream = NULL;
+
+// -----------------------------------------------------------------
+
+// Counting replacements for the global allocation functions (see gAllocationCount).
+// Not inlined, so the compiler does not pair the malloc() and free() inside them with
+// the new and delete expressions of callers (-Wmismatched-new-delete).
+__attribute__((noinline)) void *operator new(size_t size) {
+  gAllocationCount++;
+  void *memory = malloc(size ? size : 1);
+  if(memory == NULL) throw std::bad_alloc();
+  return memory;
+}
+__attribute__((noinline)) void operator delete(void *memory) noexcept {
+  free(memory);
+}
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+// Array forms, counted and freed the same way.
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+void operator delete[](void *memory) noexcept {
+  operator delete(memory);
+}
+void operator delete[](void *memory, size_t) noexcept {
+  operator delete(memory);
+}
 
 // -----------------------------------------------------------------
 
 // Function declarations - typically placed in <file>.h, but here for simplicity and reference.
 // Declaration order matches the definition order.
+double processCpuSeconds();
+void startPhase(FLPhaseClock *clock);
+void endPhase(FLPhaseClock *clock, FLPhase phase);
 void toLowerString(std::string &s);
 void trimEndOfLine(std::string &s);
 void trimLeadingWhitespace(std::string &s);
 void trimTrailingWhitespace(std::string &s);
 void cleanWord(std::string &s);
-bool wordIsMadeOfOtherWords(std::string &word, FLStringSet *stringSet);
-bool sizeHashSortFunction(std::string *a, std::string *b);
-void extractAndSortKeysFromSizeHash(FLLengthMap *sizeHash, std::vector<int> &keyVector);
-int findLongestWordsOfWords(FLStringSet *stringSet, FLLengthMap *sizeHash, std::string &firstWord, std::string &secondWord);
-bool hashStringFile(std::string &fileName, FLLengthMap **sizeHash, FLStringSet **stringSet);
+const char *findNewlineScalar(const char *s, const char *end);
+size_t skipSpacesScalar(const char *s, size_t slen);
+void lowerInPlaceScalar(char *s, size_t slen);
+#ifdef FL_HAVE_X86_SIMD
+const char *findNewlineSSE2(const char *s, const char *end);
+size_t skipSpacesSSE2(const char *s, size_t slen);
+void lowerInPlaceSSE2(char *s, size_t slen);
+const char *findNewlineAVX2(const char *s, const char *end);
+size_t skipSpacesAVX2(const char *s, size_t slen);
+void lowerInPlaceAVX2(char *s, size_t slen);
+#endif
+bool selectIngestKernel(FLIngestKernel kernel);
+size_t trimLineInPlace(char *&s, size_t slen);
+size_t cleanWordInPlace(char *&s, size_t slen);
+void initSuffixCache(FLSuffixCache *cache, size_t budgetBytes, size_t wordCount);
+bool suffixCacheLookup(FLSuffixCache *cache, uint64_t hash, const char *s, size_t slen, bool &result);
+void suffixCacheStore(FLSuffixCache *cache, uint64_t hash, const char *s, size_t slen, bool result);
+void addSuffixCacheCounters(FLSuffixCache *total, FLSuffixCache *part);
+void clearSuffixCache(FLSuffixCache *cache);
+void initFlatSet(FLFlatSet *flatSet, const FLWordStorage *wordStorage, size_t expectedWords);
+void flatSetInsert(FLFlatSet *flatSet, uint64_t hash, uint32_t wordIndex);
+bool flatSetContains(const FLFlatSet *flatSet, const char *word, size_t length);
+bool flatSetContainsHash(const FLFlatSet *flatSet, uint64_t hash, const char *word, size_t length);
+bool flatSetErase(FLFlatSet *flatSet, uint64_t hash, const char *word, size_t length);
+FLStringSet *buildStringSetFromWords(const FLWordStorage *wordStorage);
+void initBloomFilter(FLBloomFilter *bloomFilter, size_t keyCount, size_t bitsPerKey);
+void bloomInsert(FLBloomFilter *bloomFilter, uint64_t hash);
+bool bloomMayContain(const FLBloomFilter *bloomFilter, uint64_t hash);
+FLBloomFilter *buildBloomFilterFromWords(const FLWordStorage *wordStorage, size_t bitsPerKey);
+void addLengthMaskWord(FLLengthMasks *lengthMasks, const FLWordView &word);
+FLLengthMasks *buildLengthMasks(FLLengthMap *sizeHash, const FLWordStorage *wordStorage);
+void hashCheckedWord(FLSearchContext *context, const char *word, size_t wordLen);
+uint64_t substringHash(FLSearchContext *context, const char *s, size_t slen);
+bool lengthMayMatch(const FLLengthMasks *lengthMasks, const char *word, size_t length);
+bool dictionaryContains(FLSearchContext *context, const char *word, size_t length);
+void initSearchContext(FLSearchContext *context, const FLWordStorage *wordStorage, FLStringSet *stringSet,
+		       FLFlatSet *flatSet, FLTrie *trie, FLAutomaton *automaton, FLDoubleArray *doubleArray,
+		       FLDawg *dawg, FLBloomFilter *bloomFilter, FLLengthMasks *lengthMasks, FLSuffixCache *suffixCache,
+		       size_t maxWordLength);
+void fitSearchContext(FLSearchContext *context, size_t wordLength);
+bool wordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context);
+int trieFindChild(FLTrie *trie, int node, char letter);
+void trieInsert(FLTrie *trie, const FLWordView &word);
+bool trieErase(FLTrie *trie, const FLWordView &word);
+FLTrie *buildTrieFromWords(const FLWordStorage *wordStorage);
+FLDoubleArray *buildDoubleArrayFromWords(const FLWordStorage *wordStorage);
+void doubleArrayPrefixSearch(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+			     std::vector<size_t> &ends);
+void initDawgBuilder(FLDawgBuilder *builder);
+uint64_t dawgStateHash(const unsigned char *letters, const uint32_t *targets, size_t arcCount, bool final);
+uint32_t finishDawgState(FLDawgBuilder *builder, FLDawgPathState *state);
+void finishDawgPath(FLDawgBuilder *builder, size_t pathLength);
+bool addDawgWord(FLDawgBuilder *builder, const char *word, size_t length);
+FLDawg *finishDawg(FLDawgBuilder *builder);
+FLDawg *buildDawgFromWords(const FLWordStorage *wordStorage);
+uint32_t dawgFindArc(const FLDawg *dawg, uint32_t state, char letter);
+bool dawgContains(const FLDawg *dawg, const char *word, size_t length);
+void dawgPrefixSearch(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+		      std::vector<size_t> &ends);
+bool trieWordIsMadeOfOtherWords(const char *word, size_t wordLen, size_t start, FLSearchContext *context);
+bool dpWordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context);
+FLAutomaton *buildAutomatonFromWords(const FLWordStorage *wordStorage);
+uint32_t automatonNextState(const FLAutomaton *automaton, uint32_t state, unsigned char letter,
+			    FLSearchContext *context);
+bool acWordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context);
+void findAutomatonEdges(const char *word, size_t wordLen, FLSearchContext *context,
+			FLSegmentation *segmentation);
+void enterCheckCall(FLSearchContext *context);
+bool checkWord(const FLWordView &word, FLSearchContext *context);
+bool checkWordWithAlert(const FLWordView &word, FLSearchContext *context);
+void addSearchStats(FLSearchStats *total, FLSearchStats *part);
+bool sizeHashSortFunction(const FLWordView &a, const FLWordView &b);
+void extractAndSortKeysFromSizeHash(FLLengthMap *sizeHash, const FLWordStorage *wordStorage,
+				    std::vector<int> &keyVector);
+size_t longestWordLength(FLLengthMap *sizeHash);
+void searchWordChunks(const std::vector<uint32_t> *orderedWords, std::atomic<size_t> *nextChunk,
+		      std::atomic<size_t> *stopIndex, FLSearchWorker *worker);
+int findLongestWordsOfWordsParallel(FLSearchContext *context, FLLengthMap *sizeHash, std::vector<int> &keyList,
+				    std::vector<std::string> &topWords);
+int findLongestWordsOfWords(FLSearchContext *context, FLLengthMap *sizeHash, std::vector<std::string> &topWords);
+void findSegmentEdges(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+		      FLSegmentation *segmentation);
+uint64_t segmentWord(const FLWordView &word, FLSearchContext *context, FLSegmentation *segmentation);
+int printSegmentations(FLSearchContext *context, FLLengthMap *sizeHash);
+FLWordStorage *newWordStorage();
+void streamDawgWord(const FLWordView &word, unsigned long lineNumber);
+bool addWordToHashes(const FLWordView &word, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		     FLWordStorage *wordStorage);
+bool hashStringFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		    FLWordStorage **wordStorage);
+bool mapStringFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		   FLWordStorage **wordStorage);
+void loadMappedLines(char *text, size_t textLength, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		     FLWordStorage *wordStorage);
+void runLoadStep(FLLoadJob *job, void (*step)(FLLoadJob *, size_t));
+void readLoadChunk(FLLoadJob *job, size_t workerIndex);
+void splitLoadChunks(FLLoadJob *job);
+void cleanLoadChunk(FLLoadJob *job, size_t workerIndex);
+size_t loadRangeStart(size_t range, size_t rangeCount, size_t slotCount);
+void partitionLoadChunk(FLLoadJob *job, size_t workerIndex);
+FLLoadWorker *loadLineWorker(FLLoadJob *job, size_t lineNumber);
+FLLoadProbe probeLoadSlots(FLLoadJob *job, const FLLoadLine &line, size_t lineNumber, size_t slotLimit);
+void insertLoadRange(FLLoadJob *job, size_t range);
+void numberLoadChunkWords(FLLoadJob *job, size_t workerIndex);
+void renumberLoadRange(FLLoadJob *job, size_t range);
+void loadTextParallel(FLLoadJob *job, FLLengthMap *sizeHash, FLFlatSet *flatSet, FLWordStorage *wordStorage);
+void deleteWordStorage(FLWordStorage *wordStorage);
+void ownWordStorage(FLWordStorage *wordStorage, FLFlatSet *flatSet);
+uint32_t appendStoredWord(FLWordStorage *wordStorage, const FLWordView &word);
+bool writeSnapshotFile(std::string &fileName, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		       FLWordStorage *wordStorage, const FLDoubleArray *doubleArray);
+bool isSnapshotFile(std::string &fileName);
+bool mapSnapshotFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		     FLWordStorage **wordStorage, FLDoubleArray **doubleArray);
+void printStats(FLSearchContext *context, FLSuffixCache *suffixCache, int countFound);
+void stopServing(int);
+void openServeSocket(FLServer *server, const std::string &socketPath);
+bool serveCheckWord(FLServer *server, char *word, size_t wordLen);
+bool serveHasWord(FLServer *server, char *word, size_t wordLen);
+void trackServeCompounds(FLServer *server);
+bool recheckServeWord(FLServer *server, uint32_t wordIndex);
+void prepareServeUpdate(FLServer *server);
+bool addServeWord(FLServer *server, char *word, size_t wordLen);
+bool deleteServeWord(FLServer *server, char *word, size_t wordLen);
+void handleServeLine(FLServer *server, FLServeClient *client, char *line, size_t lineLen);
+bool readServeClient(FLServer *server, FLServeClient *client);
+bool writeServeClient(FLServeClient *client);
+void serveDictionary(const std::string &socketPath, FLSearchContext *context, FLLengthMap *sizeHash,
+		     FLWordStorage *wordStorage);
 void printUsage(bool doExit, char* argv[]);
+void parseLongOption(std::string &option, int argc, char* argv[], int &carg);
 void parseArguments(int argc, char* argv[], std::string &fileName);
 int main(int argc, char* argv[]);
 
 // -----------------------------------------------------------------
 
+// processCpuSeconds()
+// Requires:  None
+// Returns:   double
+// Returns the CPU time used by the process (all threads) so far, in seconds.
+double processCpuSeconds() {
+  struct timespec cpuTime;
+  if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuTime) != 0) return 0.0;
+  return cpuTime.tv_sec + cpuTime.tv_nsec * 1e-9;
+}
+
+// startPhase()
+// Requires:  FLPhaseClock *
+// Returns:   None
+// Records the wall and CPU start times of a phase.
+void startPhase(FLPhaseClock *clock) {
+  clock->wallStart = std::chrono::steady_clock::now();
+  clock->cpuStart = processCpuSeconds();
+}
+
+// endPhase()
+// Requires:  FLPhaseClock *, FLPhase
+// Returns:   None
+// Adds the wall and CPU time since startPhase() to the totals of the phase.
+void endPhase(FLPhaseClock *clock, FLPhase phase) {
+  gPhaseWallSeconds[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now()
+							     - clock->wallStart).count();
+  gPhaseCpuSeconds[phase] += processCpuSeconds() - clock->cpuStart;
+}
+
 // toLowerString()
 // Requires:  std::string reference
 // Returns:   None
@@ -206,13 +1033,672 @@ void cleanWord(std::string &s) {
   toLowerString(s);
 }
 
+// Ingest kernel functions, set by selectIngestKernel():  the first newline in [s, end)
+// (end if none), the number of leading spaces, and lower casing of ASCII letters in place.
+static const char *(*gFindNewline)(const char *s, const char *end) = findNewlineScalar;
+static size_t (*gSkipSpaces)(const char *s, size_t slen) = skipSpacesScalar;
+static void (*gLowerInPlace)(char *s, size_t slen) = lowerInPlaceScalar;
+
+// findNewlineScalar()
+// Requires:  const char *, const char *
+// Returns:   const char *
+// Scalar ingest kernel:  returns the first newline in [s, end), or end if there is none.
+const char *findNewlineScalar(const char *s, const char *end) {
+  const char *newline = (const char *)memchr(s, '\n', end - s);
+  return newline ? newline : end;
+}
+
+// skipSpacesScalar()
+// Requires:  const char *, size_t
+// Returns:   size_t
+// Scalar ingest kernel:  returns the number of leading spaces.
+size_t skipSpacesScalar(const char *s, size_t slen) {
+  size_t i = 0;
+  while(i < slen && s[i] == ' ')
+    i++;
+  return i;
+}
+
+// lowerInPlaceScalar()
+// Requires:  char *, size_t
+// Returns:   None
+// Scalar ingest kernel:  lower cases the characters with tolower(), as toLowerString()
+// does, only writing the characters that change.  The program keeps the "C" locale,
+// so only the ASCII letters A-Z change, as in the vector kernels.
+void lowerInPlaceScalar(char *s, size_t slen) {
+  for(size_t i = 0; i < slen; i++) {
+    char lower = (char)tolower((unsigned char)s[i]);
+    if(lower != s[i]) s[i] = lower;
+  }
+}
+
+#ifdef FL_HAVE_X86_SIMD
+// SSE2 and AVX2 versions of the ingest kernels.  Each compares a block of 16 or 32 bytes
+// at a time and turns the comparison into a bit mask (one bit per byte) with movemask;
+// the rest of the bytes, shorter than a block, are handled one at a time.  Upper case
+// letters are found with two signed compares ('A' - 1 < c < 'Z' + 1; bytes from 128 up
+// are negative and never match), and only the bytes set in the mask are written, so a
+// block without upper case letters is never stored (and never dirties a mapped page).
+
+// findNewlineSSE2()
+// Requires:  const char *, const char *
+// Returns:   const char *
+// SSE2 version of findNewlineScalar().
+__attribute__((target("sse2")))
+const char *findNewlineSSE2(const char *s, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  for(; end - s >= 16; s += 16) {
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)s), newline));
+    if(mask != 0) return s + __builtin_ctz(mask);
+  }
+  for(; s < end; s++)
+    if(*s == '\n') return s;
+  return end;
+}
+
+// skipSpacesSSE2()
+// Requires:  const char *, size_t
+// Returns:   size_t
+// SSE2 version of skipSpacesScalar().
+__attribute__((target("sse2")))
+size_t skipSpacesSSE2(const char *s, size_t slen) {
+  const __m128i space = _mm_set1_epi8(' ');
+  size_t i = 0;
+  for(; i + 16 <= slen; i += 16) {
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(s + i)), space));
+    if(mask != 0xffff) return i + __builtin_ctz(~mask);
+  }
+  while(i < slen && s[i] == ' ')
+    i++;
+  return i;
+}
+
+// lowerInPlaceSSE2()
+// Requires:  char *, size_t
+// Returns:   None
+// SSE2 version of lowerInPlaceScalar().
+__attribute__((target("sse2")))
+void lowerInPlaceSSE2(char *s, size_t slen) {
+  const __m128i beforeA = _mm_set1_epi8('A' - 1);
+  const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+  size_t i = 0;
+  for(; i + 16 <= slen; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(block, beforeA),
+						    _mm_cmpgt_epi8(afterZ, block)));
+    for(; mask != 0; mask &= mask - 1)
+      s[i + __builtin_ctz(mask)] += 'a' - 'A';
+  }
+  for(; i < slen; i++)
+    if(s[i] >= 'A' && s[i] <= 'Z') s[i] += 'a' - 'A';
+}
+
+// findNewlineAVX2()
+// Requires:  const char *, const char *
+// Returns:   const char *
+// AVX2 version of findNewlineScalar().
+__attribute__((target("avx2")))
+const char *findNewlineAVX2(const char *s, const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  for(; end - s >= 32; s += 32) {
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)s), newline));
+    if(mask != 0) return s + __builtin_ctz(mask);
+  }
+  for(; s < end; s++)
+    if(*s == '\n') return s;
+  return end;
+}
+
+// skipSpacesAVX2()
+// Requires:  const char *, size_t
+// Returns:   size_t
+// AVX2 version of skipSpacesScalar().
+__attribute__((target("avx2")))
+size_t skipSpacesAVX2(const char *s, size_t slen) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  size_t i = 0;
+  for(; i + 32 <= slen; i += 32) {
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(s + i)), space));
+    if(mask != 0xffffffffu) return i + __builtin_ctz(~mask);
+  }
+  while(i < slen && s[i] == ' ')
+    i++;
+  return i;
+}
+
+// lowerInPlaceAVX2()
+// Requires:  char *, size_t
+// Returns:   None
+// AVX2 version of lowerInPlaceScalar().
+__attribute__((target("avx2")))
+void lowerInPlaceAVX2(char *s, size_t slen) {
+  const __m256i beforeA = _mm256_set1_epi8('A' - 1);
+  const __m256i afterZ = _mm256_set1_epi8('Z' + 1);
+  size_t i = 0;
+  for(; i + 32 <= slen; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(block, beforeA),
+							  _mm256_cmpgt_epi8(afterZ, block)));
+    for(; mask != 0; mask &= mask - 1)
+      s[i + __builtin_ctz(mask)] += 'a' - 'A';
+  }
+  for(; i < slen; i++)
+    if(s[i] >= 'A' && s[i] <= 'Z') s[i] += 'a' - 'A';
+}
+#endif
+
+// selectIngestKernel()
+// Requires:  FLIngestKernel
+// Returns:   bool
+// Points the ingest kernel functions at the given kernel and sets kIngest to it;
+// kIngestAuto picks AVX2, then SSE2, then scalar, from what the CPU supports.
+// Returns false (and changes nothing) if the kernel is not supported by the CPU
+// or was not compiled in (the vector kernels need GCC or Clang on x86).
+bool selectIngestKernel(FLIngestKernel kernel) {
+#ifdef FL_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  bool hasSSE2 = __builtin_cpu_supports("sse2");
+  bool hasAVX2 = __builtin_cpu_supports("avx2");
+#else
+  bool hasSSE2 = false;
+  bool hasAVX2 = false;
+#endif
+  if(kernel == kIngestAuto)
+    kernel = hasAVX2 ? kIngestAVX2 : (hasSSE2 ? kIngestSSE2 : kIngestScalar);
+  if((kernel == kIngestSSE2 && !hasSSE2) || (kernel == kIngestAVX2 && !hasAVX2))
+    return false;
+  gFindNewline = findNewlineScalar;
+  gSkipSpaces = skipSpacesScalar;
+  gLowerInPlace = lowerInPlaceScalar;
+#ifdef FL_HAVE_X86_SIMD
+  if(kernel == kIngestSSE2) {
+    gFindNewline = findNewlineSSE2;
+    gSkipSpaces = skipSpacesSSE2;
+    gLowerInPlace = lowerInPlaceSSE2;
+  } else if(kernel == kIngestAVX2) {
+    gFindNewline = findNewlineAVX2;
+    gSkipSpaces = skipSpacesAVX2;
+    gLowerInPlace = lowerInPlaceAVX2;
+  }
+#endif
+  kIngest = kernel;
+  return true;
+}
+
+// trimLineInPlace()
+// Requires:  char * reference, size_t
+// Returns:   size_t
+// The trimming steps of cleanWord(), for a line in a buffer:  end of line characters,
+// then leading spaces, then trailing spaces are trimmed by moving the start pointer
+// and shrinking the returned length.  Leading spaces are skipped with the ingest
+// kernel; the trailing characters are only looked at until the first one that stays,
+// so they are trimmed one at a time.
+size_t trimLineInPlace(char *&s, size_t slen) {
+  while(slen > 0 && (s[slen - 1] == '\n' || s[slen - 1] == '\r'))
+    slen--;
+  size_t leadingSpaces = gSkipSpaces(s, slen);
+  s += leadingSpaces;
+  slen -= leadingSpaces;
+  while(slen > 0 && s[slen - 1] == ' ')
+    slen--;
+  return slen;
+}
+
+// cleanWordInPlace()
+// Requires:  char * reference, size_t
+// Returns:   size_t
+// Same cleaning as cleanWord(), for a line in a writable buffer:  the line is trimmed
+// with trimLineInPlace(), and the rest is lower cased in place with the ingest kernel.
+// Characters are only written when they change, so a clean line in a private mapping
+// never dirties its page.  Since lower casing only changes letters, which trimming
+// never removes, the loaders lower case whole blocks of lines at once and then only
+// trim each line, with the same result.
+size_t cleanWordInPlace(char *&s, size_t slen) {
+  slen = trimLineInPlace(s, slen);
+  gLowerInPlace(s, slen);
+  return slen;
+}
+
+
+// initSuffixCache()
+// Requires:  FLSuffixCache *, size_t, size_t
+// Returns:   None
+// Resets the cache counters and allocates the slot array:  the largest power of
+// two number of slots that fits in the byte budget, but no more than about four
+// slots per word in the dictionary.  A budget too small for 16 slots (e.g. 0)
+// leaves the cache disabled; lookups then return false without counting misses.
+void initSuffixCache(FLSuffixCache *cache, size_t budgetBytes, size_t wordCount) {
+  size_t slotCount = 16;
+  size_t budgetSlots = budgetBytes / sizeof(FLSuffixSlot);
+  while(2 * slotCount <= budgetSlots && slotCount < 4 * wordCount)
+    slotCount <<= 1;
+  FLSuffixSlot emptySlot = { NULL, 0, 0 };
+  if(slotCount > budgetSlots)
+    cache->slots.clear();
+  else
+    cache->slots.assign(slotCount, emptySlot);
+  cache->mask = cache->slots.size() - 1;
+  cache->maxEntries = cache->slots.size() / 2;
+  cache->entries = 0;
+  cache->bytes = cache->slots.size() * sizeof(FLSuffixSlot);
+  cache->hits = cache->misses = cache->dropped = 0;
+}
+
+// suffixCacheLookup()
+// Requires:  FLSuffixCache *, uint64_t, const char *, size_t, bool reference
+// Returns:   bool
+// Returns true and sets the result reference if the substring (with the given
+// hash) has already been tested.  A NULL or disabled cache always returns false
+// without counting a miss.
+bool suffixCacheLookup(FLSuffixCache *cache, uint64_t hash, const char *s, size_t slen, bool &result) {
+  if(cache == NULL || cache->slots.empty()) return false;
+  size_t slot = hash & cache->mask;
+  const FLSuffixSlot *current;
+  while((current = &cache->slots[slot])->data != NULL) {
+    if(current->length == slen && (current->data == s || memcmp(current->data, s, slen) == 0)) {
+      cache->hits++;
+      result = (current->result != 0);
+      return true;
+    }
+    slot = (slot + 1) & cache->mask;
+  }
+  cache->misses++;
+  return false;
+}
+
+// suffixCacheStore()
+// Requires:  FLSuffixCache *, uint64_t, const char *, size_t, bool
+// Returns:   None
+// Records the result for the substring (a view that must outlive the cache) in
+// the first empty slot of the probe sequence of its hash, or counts it as dropped
+// once the cache holds maxEntries results.
+void suffixCacheStore(FLSuffixCache *cache, uint64_t hash, const char *s, size_t slen, bool result) {
+  if(cache == NULL || cache->slots.empty()) return;
+  if(cache->entries >= cache->maxEntries) {
+    cache->dropped++;
+    return;
+  }
+  size_t slot = hash & cache->mask;
+  while(cache->slots[slot].data != NULL)
+    slot = (slot + 1) & cache->mask;
+  FLSuffixSlot newSlot = { s, (uint32_t)slen, result ? 1u : 0u };
+  cache->slots[slot] = newSlot;
+  cache->entries++;
+}
+
+// addSuffixCacheCounters()
+// Requires:  FLSuffixCache *, FLSuffixCache *
+// Returns:   None
+// Adds the counters and size of one cache (a search thread's) to a total.
+void addSuffixCacheCounters(FLSuffixCache *total, FLSuffixCache *part) {
+  total->entries += part->entries;
+  total->bytes += part->bytes;
+  total->hits += part->hits;
+  total->misses += part->misses;
+  total->dropped += part->dropped;
+}
+
+// clearSuffixCache()
+// Requires:  FLSuffixCache *
+// Returns:   None
+// Empties the slots of the cache, keeping its size and counters, so results whose
+// keys are no longer valid (e.g. a query word's buffer) cannot be found.
+void clearSuffixCache(FLSuffixCache *cache) {
+  if(cache->entries == 0) return;
+  FLSuffixSlot emptySlot = { NULL, 0, 0 };
+  std::fill(cache->slots.begin(), cache->slots.end(), emptySlot);
+  cache->entries = 0;
+}
+
+// initFlatSet()
+// Requires:  FLFlatSet *, const FLWordStorage *, size_t
+// Returns:   None
+// Empties the set of words from the storage and sizes the slot array for the
+// expected number of words at a load factor of at most 1/2.
+void initFlatSet(FLFlatSet *flatSet, const FLWordStorage *wordStorage, size_t expectedWords) {
+  size_t slotCount = 16;
+  while(slotCount < 2 * expectedWords)
+    slotCount <<= 1;
+  FLFlatSlot emptySlot = { 0, 0 };
+  flatSet->wordStorage = wordStorage;
+  flatSet->slots.assign(slotCount, emptySlot);
+  flatSet->slotTable = flatSet->slots.data();
+  flatSet->mask = slotCount - 1;
+  flatSet->count = 0;
+}
+
+// flatSetInsert()
+// Requires:  FLFlatSet *, uint64_t, uint32_t
+// Returns:   None
+// Claims the first empty slot on the probe sequence of the hash for the stored
+// word at the table index; the caller checks that the word is not in the set yet.
+// The slot array doubles (rehashing the stored words) when more than half full.
+void flatSetInsert(FLFlatSet *flatSet, uint64_t hash, uint32_t wordIndex) {
+  if(2 * (flatSet->count + 1) > flatSet->slots.size()) {
+    std::vector<FLFlatSlot> oldSlots;
+    oldSlots.swap(flatSet->slots);
+    FLFlatSlot emptySlot = { 0, 0 };
+    flatSet->slots.assign(2 * oldSlots.size(), emptySlot);
+    flatSet->mask = flatSet->slots.size() - 1;
+    for(size_t i = 0; i < oldSlots.size(); i++) {
+      if(oldSlots[i].wordNumber == 0) continue;
+      FLWordView word = storedWord(flatSet->wordStorage, oldSlots[i].wordNumber - 1);
+      size_t slot = hashWordChars(word.data, word.length) & flatSet->mask;
+      while(flatSet->slots[slot].wordNumber != 0)
+	slot = (slot + 1) & flatSet->mask;
+      flatSet->slots[slot] = oldSlots[i];
+    }
+    flatSet->slotTable = flatSet->slots.data();
+  }
+
+  size_t slot = hash & flatSet->mask;
+  while(flatSet->slots[slot].wordNumber != 0)
+    slot = (slot + 1) & flatSet->mask;
+  FLFlatSlot newSlot = { (uint32_t)(hash >> 32), wordIndex + 1 };
+  flatSet->slots[slot] = newSlot;
+  flatSet->count++;
+}
+
+// flatSetContains()
+// Requires:  const FLFlatSet *, const char *, size_t
+// Returns:   bool
+// Hashes the word and looks it up with flatSetContainsHash().
+bool flatSetContains(const FLFlatSet *flatSet, const char *word, size_t length) {
+  return flatSetContainsHash(flatSet, hashWordChars(word, length), word, length);
+}
+
+// flatSetContainsHash()
+// Requires:  const FLFlatSet *, uint64_t, const char *, size_t
+// Returns:   bool
+// Walks the probe sequence for the word's hash (from hashWordChars() or
+// substringHash()) until an empty slot.  The table entry and the characters
+// are only read for slots whose stored hash matches.
+bool flatSetContainsHash(const FLFlatSet *flatSet, uint64_t hash, const char *word, size_t length) {
+  uint32_t hashTag = (uint32_t)(hash >> 32);
+  size_t slot = hash & flatSet->mask;
+  const FLFlatSlot *current;
+  while((current = &flatSet->slotTable[slot])->wordNumber != 0) {
+    if(current->hashTag == hashTag) {
+      FLWordView stored = storedWord(flatSet->wordStorage, current->wordNumber - 1);
+      if(stored.length == length && memcmp(stored.data, word, length) == 0)
+	return true;
+    }
+    slot = (slot + 1) & flatSet->mask;
+  }
+  return false;
+}
+
+// flatSetErase()
+// Requires:  FLFlatSet * (with its own slots), uint64_t, const char *, size_t
+// Returns:   bool
+// Removes the word from the set (false if it is not there).  The slots after it on
+// its probe sequence move back into the hole when their home slot allows, so probes
+// still stop at the first empty slot and no tombstones are needed.
+bool flatSetErase(FLFlatSet *flatSet, uint64_t hash, const char *word, size_t length) {
+  uint32_t hashTag = (uint32_t)(hash >> 32);
+  size_t slot = hash & flatSet->mask;
+  for(;; slot = (slot + 1) & flatSet->mask) {
+    FLFlatSlot &current = flatSet->slots[slot];
+    if(current.wordNumber == 0) return false;
+    if(current.hashTag != hashTag) continue;
+    FLWordView stored = storedWord(flatSet->wordStorage, current.wordNumber - 1);
+    if(stored.length == length && memcmp(stored.data, word, length) == 0) break;
+  }
+
+  size_t hole = slot;
+  for(size_t next = (hole + 1) & flatSet->mask; flatSet->slots[next].wordNumber != 0;
+      next = (next + 1) & flatSet->mask) {
+    FLWordView stored = storedWord(flatSet->wordStorage, flatSet->slots[next].wordNumber - 1);
+    size_t home = hashWordChars(stored.data, stored.length) & flatSet->mask;
+    // The slot may move back unless its home lies after the hole (cyclically).
+    if(((next - home) & flatSet->mask) >= ((next - hole) & flatSet->mask)) {
+      flatSet->slots[hole] = flatSet->slots[next];
+      hole = next;
+    }
+  }
+  FLFlatSlot emptySlot = { 0, 0 };
+  flatSet->slots[hole] = emptySlot;
+  flatSet->count--;
+  return true;
+}
+
+// buildStringSetFromWords()
+// Requires:  const FLWordStorage *
+// Returns:   FLStringSet * (caller deletes)
+// Builds an STL set holding views of every stored word (for --store=stl).
+FLStringSet *buildStringSetFromWords(const FLWordStorage *wordStorage) {
+  FLStringSet *stringSet = new FLStringSet;
+  stringSet->reserve(wordStorage->wordCount);
+  for(size_t i = 0; i < wordStorage->wordCount; i++)
+    stringSet->insert(storedWord(wordStorage, i));
+  return stringSet;
+}
+
+// initBloomFilter()
+// Requires:  FLBloomFilter *, size_t, size_t (> 0)
+// Returns:   None
+// Empties the filter and sizes it for the number of words at the bits per word, in
+// whole 64 byte blocks, with the number of probes that is best for that ratio (about
+// ln 2 bits per probe), from 1 to kBloomMaxProbes.
+void initBloomFilter(FLBloomFilter *bloomFilter, size_t keyCount, size_t bitsPerKey) {
+  size_t blockBits = 64 * kBloomBlockWords;
+  bloomFilter->blockCount = std::max((size_t)1, (keyCount * bitsPerKey + blockBits - 1) / blockBits);
+  bloomFilter->probeCount = std::min(kBloomMaxProbes, std::max(1u, (unsigned)(bitsPerKey * 0.69 + 0.5)));
+  bloomFilter->words.assign((bloomFilter->blockCount + 1) * kBloomBlockWords, 0);
+  uintptr_t address = (uintptr_t)bloomFilter->words.data();
+  bloomFilter->blocks = bloomFilter->words.data() + ((64 - address % 64) % 64) / sizeof(uint64_t);
+}
+
+// bloomInsert()
+// Requires:  FLBloomFilter *, uint64_t
+// Returns:   None
+// Sets the bits of the word hash in its block.
+void bloomInsert(FLBloomFilter *bloomFilter, uint64_t hash) {
+  uint64_t *block = bloomFilter->blocks + ((hash >> 32) * bloomFilter->blockCount >> 32) * kBloomBlockWords;
+  uint64_t bits = mixHash(hash);
+  uint32_t bit = (uint32_t)bits, step = (uint32_t)(bits >> 32) | 1;
+  for(unsigned i = 0; i < bloomFilter->probeCount; i++, bit += step)
+    block[(bit >> 6) & (kBloomBlockWords - 1)] |= (uint64_t)1 << (bit & 63);
+}
+
+// bloomMayContain()
+// Requires:  const FLBloomFilter *, uint64_t
+// Returns:   bool
+// Returns false if the word of the hash is certainly not in the filter (a bit of its
+// block is clear), true if it may be.
+bool bloomMayContain(const FLBloomFilter *bloomFilter, uint64_t hash) {
+  const uint64_t *block = bloomFilter->blocks + ((hash >> 32) * bloomFilter->blockCount >> 32) * kBloomBlockWords;
+  uint64_t bits = mixHash(hash);
+  uint32_t bit = (uint32_t)bits, step = (uint32_t)(bits >> 32) | 1;
+  for(unsigned i = 0; i < bloomFilter->probeCount; i++, bit += step)
+    if(!(block[(bit >> 6) & (kBloomBlockWords - 1)] & ((uint64_t)1 << (bit & 63))))
+      return false;
+  return true;
+}
+
+// buildBloomFilterFromWords()
+// Requires:  const FLWordStorage *, size_t (> 0)
+// Returns:   FLBloomFilter * (caller deletes)
+// Builds the Bloom filter of every stored word at the bits per word.
+FLBloomFilter *buildBloomFilterFromWords(const FLWordStorage *wordStorage, size_t bitsPerKey) {
+  FLBloomFilter *bloomFilter = new FLBloomFilter;
+  initBloomFilter(bloomFilter, wordStorage->wordCount, bitsPerKey);
+  for(size_t i = 0; i < wordStorage->wordCount; i++) {
+    FLWordView word = storedWord(wordStorage, i);
+    bloomInsert(bloomFilter, hashWordChars(word.data, word.length));
+  }
+  return bloomFilter;
+}
+
+// addLengthMaskWord()
+// Requires:  FLLengthMasks *, const FLWordView reference (not empty)
+// Returns:   None
+// Sets the bits of the length of the word (growing the length mask as needed) and
+// widens the length bounds.
+void addLengthMaskWord(FLLengthMasks *lengthMasks, const FLWordView &word) {
+  size_t length = word.length;
+  if(lengthMasks->lengths.size() <= length / 64)
+    lengthMasks->lengths.resize(length / 64 + 1, 0);
+  lengthMasks->lengths[length / 64] |= 1ULL << (length % 64);
+  if(length < 64)
+    lengthMasks->firstLetterLengths[(unsigned char)word.data[0]] |= 1ULL << length;
+  if(lengthMasks->minLength == 0 || length < lengthMasks->minLength)
+    lengthMasks->minLength = length;
+  if(length > lengthMasks->maxLength)
+    lengthMasks->maxLength = length;
+}
+
+// buildLengthMasks()
+// Requires:  FLLengthMap *, const FLWordStorage *
+// Returns:   FLLengthMasks * (caller deletes)
+// Builds the length masks of the words in the length map.  An empty dictionary
+// leaves minLength at 1, so every length is skipped.
+FLLengthMasks *buildLengthMasks(FLLengthMap *sizeHash, const FLWordStorage *wordStorage) {
+  FLLengthMasks *lengthMasks = new FLLengthMasks;
+  memset(lengthMasks->firstLetterLengths, 0, sizeof(lengthMasks->firstLetterLengths));
+  lengthMasks->minLength = 0;
+  lengthMasks->maxLength = 0;
+  for(FLLengthMap::const_iterator it = sizeHash->begin(); it != sizeHash->end(); ++it) {
+    for(size_t i = 0; i < it->second.size(); i++)
+      addLengthMaskWord(lengthMasks, storedWord(wordStorage, it->second[i]));
+  }
+  if(lengthMasks->minLength == 0)
+    lengthMasks->minLength = 1;
+  return lengthMasks;
+}
+
+// initSearchContext()
+// Requires:  FLSearchContext *, const FLWordStorage *, FLStringSet *, FLFlatSet *, FLTrie *,
+//            FLAutomaton *, FLDoubleArray *, FLDawg *, FLBloomFilter *, FLLengthMasks *,
+//            FLSuffixCache *, size_t
+// Returns:   None
+// Stores the structures for the checkers and reserves the scratch vectors for the
+// longest word, so that checking words does not allocate.
+void initSearchContext(FLSearchContext *context, const FLWordStorage *wordStorage, FLStringSet *stringSet,
+		       FLFlatSet *flatSet, FLTrie *trie, FLAutomaton *automaton, FLDoubleArray *doubleArray,
+		       FLDawg *dawg, FLBloomFilter *bloomFilter, FLLengthMasks *lengthMasks, FLSuffixCache *suffixCache,
+		       size_t maxWordLength) {
+  context->wordStorage = wordStorage;
+  context->stringSet = stringSet;
+  context->flatSet = flatSet;
+  context->trie = trie;
+  context->automaton = automaton;
+  context->doubleArray = doubleArray;
+  context->dawg = dawg;
+  context->bloomFilter = bloomFilter;
+  context->lengthMasks = lengthMasks;
+  context->suffixCache = suffixCache;
+  context->maxWordLength = maxWordLength;
+  context->trieBoundaries.clear();
+  context->trieBoundaries.reserve(4 * maxWordLength);
+  context->dpReachable.reserve(maxWordLength + 1);
+  context->hashedWord = NULL;
+  context->prefixHashes.reserve(maxWordLength + 1);
+  context->hashPowers.assign(1, 1);
+  for(size_t i = 1; i <= maxWordLength; i++)
+    context->hashPowers.push_back(context->hashPowers.back() * kHashBase);
+  context->checkDepth = 0;
+  memset(&context->stats, 0, sizeof(context->stats));
+}
+
+// fitSearchContext()
+// Requires:  FLSearchContext *, size_t
+// Returns:   None
+// Extends the powers of the hash base (and the scratch space) of the context for
+// checking a word longer than the longest dictionary word, e.g. a query word.
+void fitSearchContext(FLSearchContext *context, size_t wordLength) {
+  if(wordLength < context->hashPowers.size()) return;
+  while(context->hashPowers.size() <= wordLength)
+    context->hashPowers.push_back(context->hashPowers.back() * kHashBase);
+  context->trieBoundaries.reserve(4 * wordLength);
+  context->dpReachable.reserve(wordLength + 1);
+  context->prefixHashes.reserve(wordLength + 1);
+}
+
+// hashCheckedWord()
+// Requires:  FLSearchContext *, const char *, size_t (<= maxWordLength of the context)
+// Returns:   None
+// Computes the (unmixed) polynomial hashes of all prefixes of the word about to be
+// checked, in one pass, so substringHash() can hash any of its substrings in constant time.
+void hashCheckedWord(FLSearchContext *context, const char *word, size_t wordLen) {
+  std::vector<uint64_t> &prefixHashes = context->prefixHashes;
+  prefixHashes.resize(wordLen + 1);
+  prefixHashes[0] = 0;
+  for(size_t i = 0; i < wordLen; i++)
+    prefixHashes[i + 1] = extendHash(prefixHashes[i], word[i]);
+  context->hashedWord = word;
+  context->stats.hashedChars += wordLen;
+}
+
+// substringHash()
+// Requires:  FLSearchContext *, const char *, size_t
+// Returns:   uint64_t
+// Returns hashWordChars() of the substring.  For a substring of the hashed word,
+// the polynomial hash is prefixHashes[end] - prefixHashes[start] * base^length
+// (mod 2^64), then mixed; otherwise (no hashed word) it is computed from the characters.
+uint64_t substringHash(FLSearchContext *context, const char *s, size_t slen) {
+  if(context->hashedWord == NULL) {
+    context->stats.hashedChars += slen;
+    return hashWordChars(s, slen);
+  }
+  size_t start = s - context->hashedWord;
+  uint64_t endHash = context->prefixHashes[start + slen];
+  return mixHash(endHash - context->prefixHashes[start] * context->hashPowers[slen]);
+}
+
+// lengthMayMatch()
+// Requires:  const FLLengthMasks *, const char *, size_t (> 0)
+// Returns:   bool
+// False if no stored word has the length (or, below 64, no word of the length starts
+// with the first character), so the characters cannot be a word.
+bool lengthMayMatch(const FLLengthMasks *lengthMasks, const char *word, size_t length) {
+  if(length < 64)
+    return (lengthMasks->firstLetterLengths[(unsigned char)word[0]] >> length) & 1;
+  if(length > lengthMasks->maxLength)
+    return false;
+  return (lengthMasks->lengths[length / 64] >> (length % 64)) & 1;
+}
+
+// dictionaryContains()
+// Requires:  FLSearchContext *, const char *, size_t
+// Returns:   bool
+// Looks the characters up in the store selected by kStore (flat set if built, the
+// DAWG of the dawg engine, string set otherwise) and counts the lookup.  Lengths the
+// length masks rule out are skipped first, and with a Bloom filter the store is only
+// read if the filter may hold the characters.
+bool dictionaryContains(FLSearchContext *context, const char *word, size_t length) {
+  if(!lengthMayMatch(context->lengthMasks, word, length)) {
+    context->stats.lengthSkips++;
+    return false;
+  }
+  context->stats.lookups++;
+  uint64_t hash = 0;
+  if(context->bloomFilter != NULL || context->flatSet != NULL)
+    hash = substringHash(context, word, length);
+  if(context->bloomFilter != NULL && !bloomMayContain(context->bloomFilter, hash)) {
+    context->stats.bloomNegatives++;
+    return false;
+  }
+  bool found;
+  if(context->flatSet != NULL)
+    found = flatSetContainsHash(context->flatSet, hash, word, length);
+  else if(context->dawg != NULL)
+    found = dawgContains(context->dawg, word, length);
+  else
+    found = context->stringSet->count(FLWordView{ word, length }) > 0;
+  if(context->bloomFilter != NULL && !found)
+    context->stats.bloomFalsePositives++;
+  return found;
+}
 
 // wordIsMadeOfOtherWords()
-// Requires:  std::string reference, FLStringSet *
+// Requires:  const char *, size_t, FLSearchContext *
 // Returns:   bool
 //
-// Recursive function looks for matches of the passed string reference and
-// its substrings against the keys in the passed FLStringSet (pointer ref).
+// Recursive function looks for matches of the passed characters (a view of the
+// word or one of its suffixes, never copied) and its substrings, given as pointer
+// and length, against the words in the store of the passed search context,
+// using the suffix cache of the context (if any) around the recursive calls.
 //
 // (1) Start at beginning of word with a primary substring size - 1.
 //     A greedy matching algorithm shrinking to a match yields more efficient
@@ -221,8 +1707,10 @@ void cleanWord(std::string &s) {
 //     The initial remaining substring is (size - (size - 1)), or 1.
 //     NOTE:  Never having a primary substring of the full size means not
 //            having to worry about matching the full word with itself.
-// (2) While the substring length is greater than 0 and a match has not been
-//     found, loop over the substring testing.
+//     With the length masks, the primary substring starts at the longest word
+//     length and leaves at least the shortest word length remaining.
+// (2) While the substring length is at least the shortest word length and a match
+//     has not been found, loop over the substring testing.
 //     (2a)  Create and test primary substring
 //     (2b)  If primary substring matches:
 //              Create and test secondary substring
@@ -234,6 +1722,10 @@ void cleanWord(std::string &s) {
 //              Shrink primary substring, grow remaining substring,
 //               and return to head of loop (2)
 //
+// The result of each recursive call depends only on the remaining substring, so it
+// is looked up in (and saved to) the suffix cache around the call.  This turns the
+// exponential worst case of repeated suffixes ("aaaa...ab") into one test per suffix.
+//
 // NOTE:  The check for substring match could be done at the head of the function,
 //        except:
 //        (1) It then requires a check for call level (is it the full word?)
@@ -244,183 +1736,2705 @@ void cleanWord(std::string &s) {
 // Call level information is not required given the construction of primary substring,
 // but it could be interesting to analyze the average and max call depths.
 // bool wordIsMadeOfOtherWords(std::string &word, FLStringSet *stringSet, int level) {
-bool wordIsMadeOfOtherWords(std::string &word, FLStringSet *stringSet) {
+bool wordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context) {
   // Original base case check for empty is no longer necessary - removed.
 
-  int sublen = word.length() - 1;  // greedy initial primary substring, never full word
-  int remlen = 1;
-  while(sublen > 0) {
-    std::string partWord = word.substr(0, sublen);   // primary substring
+  size_t minLength = context->lengthMasks->minLength;
+  // greedy initial primary substring, never full word
+  size_t sublen = wordLen > minLength ? std::min(wordLen - minLength, context->maxWordLength) : 0;
+  size_t remlen = wordLen - sublen;
+  while(sublen >= minLength) {
+    const char *remainingString = word + sublen;   // primary substring is (word, sublen)
 
-    if(kDoDebug) printf("Testing partial word %s\n", partWord.c_str());
-    if(stringSet->count(partWord) > 0) {
-      if(kDoDebug) printf("Match found with partial word %s, start %d, length %d\n", partWord.c_str(), 0, sublen);
+    if(kDoDebug) printf("Testing partial word %.*s\n", (int)sublen, word);
+    if(dictionaryContains(context, word, sublen)) {
+      if(kDoDebug) printf("Match found with partial word %.*s, start %d, length %d\n", (int)sublen, word, 0, (int)sublen);
 
-      std::string remainingString = word.substr(sublen, remlen);  // secondary substring
-      if(stringSet->count(remainingString) > 0) {
-	if(kDoDebug) printf("Match found with remaining string %s\n", remainingString.c_str());
+      if(dictionaryContains(context, remainingString, remlen)) {   // secondary substring
+	if(kDoDebug) printf("Match found with remaining string %.*s\n", (int)remlen, remainingString);
 	return true;
       }
 
-      if(kDoDebug) printf("Calling recursive function with remaining string %s\n", remainingString.c_str());
-      //      if(wordIsMadeOfOtherWords(remainingString, stringSet, level + 1))
-      if(wordIsMadeOfOtherWords(remainingString, stringSet))
-      return true;
+      bool remainingResult;
+      uint64_t remainingHash = substringHash(context, remainingString, remlen);
+      if(suffixCacheLookup(context->suffixCache, remainingHash, remainingString, remlen, remainingResult)) {
+	if(kDoDebug) printf("Cached result %d for remaining string %.*s\n", remainingResult, (int)remlen, remainingString);
+      } else {
+	if(kDoDebug) printf("Calling recursive function with remaining string %.*s\n", (int)remlen, remainingString);
+	//      if(wordIsMadeOfOtherWords(remainingString, stringSet, level + 1))
+	enterCheckCall(context);
+	remainingResult = wordIsMadeOfOtherWords(remainingString, remlen, context);
+	context->checkDepth--;
+	suffixCacheStore(context->suffixCache, remainingHash, remainingString, remlen, remainingResult);
+      }
+      if(remainingResult)
+	return true;
     }
     sublen--;  // decrease primary substring
     remlen++;  // increase remaining substring
   }
 
-  if(kDoDebug) printf("Word %s is not made of other words in the set\n", word.c_str());
+  if(kDoDebug) printf("Word %.*s is not made of other words in the set\n", (int)wordLen, word);
   return false;
 }
 
 
-// sizeHashSortFunction()
-// Requires:  std::string *, std::string *
-// Returns:   bool
-// The function dereferences two string pointers and compares the second to the first.
-// Used for std::sort() with iterators for a vector of std::string *.
-// std::sort() expects a boolean result of (a < b), not the integer results
-// of (<0, 0, or >0) supplied by string.compare() or strcmp().
-bool sizeHashSortFunction(std::string *a, std::string *b) {
-  //  return (a->compare(*b) < 0);
-  return (strcmp(a->c_str(), b->c_str()) < 0);  // faster than object compare
+// trieFindChild()
+// Requires:  FLTrie *, int, char
+// Returns:   int
+// Returns the index of the child of the given node holding the letter, or -1.
+int trieFindChild(FLTrie *trie, int node, char letter) {
+  int child = (*trie)[node].firstChild;
+  while(child >= 0 && (*trie)[child].letter != letter)
+    child = (*trie)[child].nextSibling;
+  return child;
 }
 
-
-// extractAndSortKeysFromSizeHash()
-// Requires:  FLLengthMap *, std::vector<int> reference (should be empty)
+// trieInsert()
+// Requires:  FLTrie *, const FLWordView reference
 // Returns:   None
-// The function pulls the (key, value) pairs from the string size hash, where the
-// keys are integer string lengths and the values are vectors of std::string *.
-// It adds the integer string lengths (keys) to the empty provided vector reference.
-// -- It optionally sorts the vectors of std::string * if requested by the command
-//    line option.
-// It finally sorts the vector of integer key lengths.
-void extractAndSortKeysFromSizeHash(FLLengthMap *sizeHash, std::vector<int> &keyVector) {
-  for(auto sizeHashIter = sizeHash->begin(); sizeHashIter != sizeHash->end(); ++sizeHashIter) {
-    keyVector.push_back(sizeHashIter->first);
-    if(kDoPreSort) std::sort((sizeHashIter->second).begin(), (sizeHashIter->second).end(),
-    			     sizeHashSortFunction);
+// Adds the word to the trie, creating missing nodes as new first children,
+// and marks the node for the last letter as an end of word.
+void trieInsert(FLTrie *trie, const FLWordView &word) {
+  int node = 0;
+  for(size_t i = 0; i < word.length; i++) {
+    int child = trieFindChild(trie, node, word.data[i]);
+    if(child < 0) {
+      FLTrieNode newNode = { -1, (*trie)[node].firstChild, word.data[i], false };
+      child = trie->size();
+      trie->push_back(newNode);
+      (*trie)[node].firstChild = child;
+    }
+    node = child;
   }
-  std::sort(keyVector.begin(), keyVector.end());
+  (*trie)[node].endOfWord = true;
 }
 
-// findLongestWordsOfWords()
-// Requires:  FLStringSet *, FLLengthMap *, std::string reference, std::string reference
-// Returns:   int
-// The function takes pointers to populated FLStringSet and FLLengthMap objects, and references
-// to string objects for the requested first and second longest words made of other words.
-// (1) It extracts and sorts the string length keys (number should be <= longest words)
-//     from the FLLengthMap, and initializes a loop counter to start with the largest key.
-// (2) While the key index is in range:
-//     (2a) Get a pointer to the vector of std::string * at the key index
-//     (2b) Get the size of the vector and initialize a loop counter (word index)
-//     (2c) While the word index is in range:
-//          (2d) Get the std::string * at the word index and check if it is made of other words
-//               If match:  increment count of found words of other words, and potentially
-//                          store word in the provided first or second word references,
-//                          if either has not already been found.
-// The function returns the final count of words made of other words in the string set.
-int findLongestWordsOfWords(FLStringSet *stringSet, FLLengthMap *sizeHash, std::string &firstWord, std::string &secondWord) {
-  firstWord = secondWord = "";
-  bool firstFound = false, secondFound = false;
-  int countFound = 0;
+// trieErase()
+// Requires:  FLTrie *, const FLWordView reference
+// Returns:   bool
+// Clears the end of word marker of the word (false if it is not in the trie).
+// The nodes stay, so words sharing the path are not affected.
+bool trieErase(FLTrie *trie, const FLWordView &word) {
+  int node = 0;
+  for(size_t i = 0; i < word.length && node >= 0; i++)
+    node = trieFindChild(trie, node, word.data[i]);
+  if(node <= 0 || !(*trie)[node].endOfWord) return false;
+  (*trie)[node].endOfWord = false;
+  return true;
+}
 
-  std::vector<int> keyList;
-  extractAndSortKeysFromSizeHash(sizeHash, keyList);
+// buildTrieFromWords()
+// Requires:  const FLWordStorage *
+// Returns:   FLTrie * (caller deletes)
+// Builds a trie holding every stored word.
+FLTrie *buildTrieFromWords(const FLWordStorage *wordStorage) {
+  FLTrie *trie = new FLTrie;
+  FLTrieNode root = { -1, -1, '\0', false };
+  trie->push_back(root);
+  for(size_t i = 0; i < wordStorage->wordCount; i++)
+    trieInsert(trie, storedWord(wordStorage, i));
+  return trie;
+}
 
-  int keyListIndex, listLength, wordListIndex;
-  for(keyListIndex = keyList.size() - 1; keyListIndex >= 0; keyListIndex--) {
-    std::vector<std::string *> *wordList = &(*sizeHash)[keyList[keyListIndex]];
-    listLength = wordList->size();
+// buildDoubleArrayFromWords()
+// Requires:  const FLWordStorage *
+// Returns:   FLDoubleArray * (caller deletes)
+// Builds the double-array trie of every stored word, without a pointer trie:  the
+// word table indices are sorted by their words, so the words below a node at depth d
+// are a range of the sorted list, and its children are the runs of equal letters at
+// d (after the word ending at the node, if any, which sorts first).  Nodes are placed
+// depth first from an explicit stack.  The base of a node is the first one, from
+// firstFree, whose units for all of the child codes are free; firstFree moves past
+// the front of the array once it is (almost) full, as in the usual double-array
+// builders, so the search does not rescan it for every node.  More than 2^31 units
+// cause an immediate exit.
+FLDoubleArray *buildDoubleArrayFromWords(const FLWordStorage *wordStorage) {
+  size_t wordCount = wordStorage->wordCount;
+  std::vector<uint32_t> sortedWords(wordCount);
+  for(size_t i = 0; i < wordCount; i++)
+    sortedWords[i] = i;
+  FLWordIndexLess wordIndexLess = { wordStorage };
+  std::sort(sortedWords.begin(), sortedWords.end(), wordIndexLess);
 
-    for(wordListIndex = 0; wordListIndex < listLength; wordListIndex++) {
-      std::string *word = (*wordList)[wordListIndex];
-      if(kDoDebug) printf("Trying word %s\n", word->c_str());
-      //      if(wordIsMadeOfOtherWords(*word, stringSet, 0)) {     // no longer need call level
-      if(wordIsMadeOfOtherWords(*word, stringSet)) {
-	if(kDoDebug) printf("Word %s is made of other words.\n", word->c_str());
-	countFound++;
-	if(!secondFound) {
-	  if(!firstFound) {
-	    firstWord = *word;
-	    firstFound = true;
-	  } else {
-	    secondWord = *word;
-	    secondFound = true;
-	  }
-	}
-      }
-    }
+  FLDoubleArray *doubleArray = new FLDoubleArray;
+  memset(doubleArray->codes, 0, sizeof(doubleArray->codes));
+  for(size_t i = 0; i < wordCount; i++) {
+    FLWordView word = storedWord(wordStorage, i);
+    for(size_t j = 0; j < word.length; j++)
+      doubleArray->codes[(unsigned char)word.data[j]] = 1;
   }
-  return countFound;
-}
+  size_t codeCount = 0;
+  for(size_t i = 0; i < 256; i++)
+    if(doubleArray->codes[i]) doubleArray->codes[i] = ++codeCount;
 
-// hashStringFile()
-// Requires:  std::string reference, FLLengthMap **, FLStringSet **
-// Returns:   bool
-// The function takes a string reference to a file name and attempts to open
-// the file.  Failure causes an immediate exit.
-// On success, it initializes the provided double pointers with a new empty
-// string set and length map (hash).  For each line in the file, it "cleans"
-// the word in the line and then measures its length.  It adds a non-empty
-// word to the string set and adds the pointer to the inserted word into
-// a vector in the length map, keyed by the length of the word.
-// A set insertion failure will terminate the function early and return false.
-bool hashStringFile(std::string &fileName, FLLengthMap **sizeHash, FLStringSet **stringSet) {
-  std::ifstream fileStream(fileName);
-  if(!fileStream.good()) {
-    printf("ERROR:  Couldn't open file %s for input.\n", fileName.c_str());
-    exit(1);
+  std::vector<FLDoubleArrayUnit> &units = doubleArray->units;
+  FLDoubleArrayUnit freeUnit = { 0, kDoubleArrayFree };
+  units.assign(codeCount + 1, freeUnit);
+  units[0].check = 0;   // the root is never a child (codes start at 1)
+  size_t firstFree = 1;
+  // A node to place:  its unit, the range [first, last) of sorted words below it, and its depth.
+  struct FLDoubleArrayNode {
+    uint32_t unit;
+    size_t first;
+    size_t last;
+    size_t depth;
+  };
+  std::vector<FLDoubleArrayNode> pending;
+  if(wordCount > 0) {
+    FLDoubleArrayNode root = { 0, 0, wordCount, 0 };
+    pending.push_back(root);
   }
-  *stringSet = new FLStringSet;
-  *sizeHash = new FLLengthMap;
-  size_t lineLen;
-
-  for(std::string line; std::getline(fileStream, line);) {
-    cleanWord(line);
-    lineLen = line.length();
-    if(lineLen > 0) {
-      //      if(kDoDebug) printf("Adding word %s of length %lu\n", line.c_str(), lineLen);
-      std::pair<FLSetIterator, bool> insertResult = (*stringSet)->insert(line);
-      if(insertResult.second) {
-	// NOTE:  STL hash creates new vectors automatically when using [] operator with an unknown key.
-      	(**sizeHash)[lineLen].push_back((std::string *)&(*(insertResult.first)));
-      } else {
-      	printf("ERROR:  A string was not inserted into the string set.\n");
-	fileStream.close();
-	return false;
+  std::vector<std::pair<uint32_t, size_t> > children;   // (code, first sorted word)
+  while(!pending.empty()) {
+    FLDoubleArrayNode node = pending.back();
+    pending.pop_back();
+    size_t first = node.first;
+    bool terminal = storedWord(wordStorage, sortedWords[first]).length == node.depth;
+    if(terminal) first++;
+    children.clear();
+    for(size_t i = first; i < node.last; i++) {
+      uint32_t code = doubleArray->codes[(unsigned char)storedWord(wordStorage, sortedWords[i]).data[node.depth]];
+      if(children.empty() || children.back().first != code)
+	children.push_back(std::make_pair(code, i));
+    }
+    uint32_t base = 0;
+    if(!children.empty()) {
+      size_t usedSeen = 0, position = std::max(firstFree, (size_t)children[0].first);
+      for(;; position++) {
+	if(position + codeCount >= units.size())
+	  units.resize(std::max(2 * units.size(), position + codeCount + 1), freeUnit);
+	if(units[position].check != kDoubleArrayFree) {
+	  usedSeen++;
+	  continue;
+	}
+	size_t candidate = position - children[0].first;
+	size_t i = 1;
+	while(i < children.size() && units[candidate + children[i].first].check == kDoubleArrayFree)
+	  i++;
+	if(i == children.size()) {
+	  base = candidate;
+	  break;
+	}
+      }
+      // Skip the front of the array once nearly all of the units searched are used.
+      if(usedSeen * 20 >= (position - firstFree + 1) * 19)
+	firstFree = position;
+      if(base + codeCount >= kDoubleArrayTerminal) {
+	printf("ERROR:  Too many words for the double-array trie.\n");
+	exit(1);
+      }
+      for(size_t i = 0; i < children.size(); i++)
+	units[base + children[i].first].check = node.unit;
+      for(size_t i = children.size(); i > 0; i--) {
+	size_t childLast = (i == children.size()) ? node.last : children[i].second;
+	FLDoubleArrayNode child = { (uint32_t)(base + children[i - 1].first), children[i - 1].second,
+				    childLast, node.depth + 1 };
+	pending.push_back(child);
       }
     }
+    units[node.unit].base = base | (terminal ? kDoubleArrayTerminal : 0);
   }
-  fileStream.close();
-  return true;
+
+  size_t unitCount = units.size();
+  while(unitCount > 1 && units[unitCount - 1].check == kDoubleArrayFree)
+    unitCount--;
+  units.resize(unitCount);
+  units.shrink_to_fit();
+  doubleArray->unitTable = units.data();
+  doubleArray->unitCount = unitCount;
+  return doubleArray;
 }
 
-// printUsage()
-// Requires:  bool, char*
+// doubleArrayPrefixSearch()
+// Requires:  const char *, size_t, size_t, FLSearchContext *, std::vector<size_t> reference
 // Returns:   None
-// The function will print out the usage of the program, using argv[0] as the
+// Common prefix search from any position of a word:  walks the double array of the
+// context from the start position, and appends the end position of every dictionary
+// word starting there (increasing) to ends.  The walk counts as one lookup, and each
+// unit entered as a trie node step.
+void doubleArrayPrefixSearch(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+			     std::vector<size_t> &ends) {
+  const FLDoubleArray *doubleArray = context->doubleArray;
+  const FLDoubleArrayUnit *units = doubleArray->unitTable;
+  uint32_t node = 0;
+  context->stats.lookups++;
+  for(size_t pos = start; pos < wordLen; pos++) {
+    uint32_t code = doubleArray->codes[(unsigned char)word[pos]];
+    size_t next = (units[node].base & ~kDoubleArrayTerminal) + code;
+    if(code == 0 || next >= doubleArray->unitCount || units[next].check != node) break;
+    node = next;
+    context->stats.trieNodeSteps++;
+    if(units[node].base & kDoubleArrayTerminal)
+      ends.push_back(pos + 1);
+  }
+}
+
+// initDawgBuilder()
+// Requires:  FLDawgBuilder *
+// Returns:   None
+// Starts the construction of a DAWG (see FLDawgBuilder):  an empty automaton, a path
+// holding only the root, and an empty register.
+void initDawgBuilder(FLDawgBuilder *builder) {
+  builder->dawg = new FLDawg;
+  builder->dawg->root = 0;
+  builder->path.clear();
+  builder->path.resize(1);
+  builder->pathLength = 1;
+  builder->registry.assign(1024, kDawgNoSlot);
+  builder->registered = 0;
+}
+
+// dawgStateHash()
+// Requires:  const unsigned char *, const uint32_t *, size_t, bool
+// Returns:   uint64_t
+// Hashes the arcs (letters and targets) and the finality of a state for the register.
+uint64_t dawgStateHash(const unsigned char *letters, const uint32_t *targets, size_t arcCount, bool final) {
+  uint64_t hash = final ? kHashBase : 0;
+  for(size_t i = 0; i < arcCount; i++)
+    hash = mixHash(hash ^ ((uint64_t)letters[i] << 32 | targets[i]));
+  return mixHash(hash + arcCount);
+}
+
+// finishDawgState()
+// Requires:  FLDawgBuilder *, FLDawgPathState * (whose arcs all have their targets)
+// Returns:   uint32_t
+// Returns the finished state equal to the path state (same finality, letters, and
+// targets) from the register, or adds the path state to the automaton and to the
+// register and returns its number.  The path state is cleared for reuse.  The
+// register doubles when half full.  More than 2^31 states cause an immediate exit.
+uint32_t finishDawgState(FLDawgBuilder *builder, FLDawgPathState *state) {
+  FLDawg *dawg = builder->dawg;
+  std::vector<uint64_t> &registry = builder->registry;
+  size_t arcCount = state->letters.size();
+  uint32_t arcWord = arcCount | (state->final ? kDawgFinal : 0);
+  uint64_t hash = dawgStateHash(state->letters.data(), state->targets.data(), arcCount, state->final);
+  size_t mask = registry.size() - 1;
+  size_t slot = (hash >> 32) & mask;
+  uint32_t result = kDawgNoState;
+  for(; registry[slot] != kDawgNoSlot; slot = (slot + 1) & mask) {
+    if((registry[slot] ^ hash) >> 32) continue;
+    const FLDawgState &other = dawg->states[(uint32_t)registry[slot]];
+    if(other.arcCount == arcWord &&
+       memcmp(&dawg->arcLetters[other.firstArc], state->letters.data(), arcCount) == 0 &&
+       memcmp(&dawg->arcTargets[other.firstArc], state->targets.data(), arcCount * sizeof(uint32_t)) == 0) {
+      result = (uint32_t)registry[slot];
+      break;
+    }
+  }
+  if(result == kDawgNoState) {
+    if(dawg->states.size() >= kDawgFinal) {
+      printf("ERROR:  Too many states for the DAWG.\n");
+      exit(1);
+    }
+    FLDawgState newState = { (uint32_t)dawg->arcLetters.size(), arcWord };
+    result = dawg->states.size();
+    dawg->states.push_back(newState);
+    dawg->arcLetters.insert(dawg->arcLetters.end(), state->letters.begin(), state->letters.end());
+    dawg->arcTargets.insert(dawg->arcTargets.end(), state->targets.begin(), state->targets.end());
+    registry[slot] = (hash & ~(uint64_t)UINT32_MAX) | result;
+    if(++builder->registered * 2 > registry.size()) {
+      std::vector<uint64_t> oldRegistry(2 * registry.size(), kDawgNoSlot);
+      oldRegistry.swap(registry);
+      mask = registry.size() - 1;
+      for(size_t i = 0; i < oldRegistry.size(); i++) {
+	if(oldRegistry[i] == kDawgNoSlot) continue;
+	for(slot = (oldRegistry[i] >> 32) & mask; registry[slot] != kDawgNoSlot; slot = (slot + 1) & mask)
+	  ;
+	registry[slot] = oldRegistry[i];
+      }
+    }
+  }
+  state->letters.clear();
+  state->targets.clear();
+  state->final = false;
+  return result;
+}
+
+// finishDawgPath()
+// Requires:  FLDawgBuilder *, size_t (>= 1)
+// Returns:   None
+// Finishes the path states from the deepest one up to (not including) the given path
+// length, setting the last arc target of each parent, and shortens the path to it.
+void finishDawgPath(FLDawgBuilder *builder, size_t pathLength) {
+  std::vector<FLDawgPathState> &path = builder->path;
+  for(size_t d = builder->pathLength - 1; d >= pathLength; d--)
+    path[d - 1].targets.back() = finishDawgState(builder, &path[d]);
+  builder->pathLength = pathLength;
+}
+
+// addDawgWord()
+// Requires:  FLDawgBuilder *, const char *, size_t
+// Returns:   bool
+// Adds the word to the DAWG under construction.  The words must come in increasing
+// order (as sizeHashSortFunction() sorts them):  returns false, adding nothing, if the
+// word is empty or not greater than the last word added.  The path states below the
+// common prefix with the last word are finished, and the rest of the word is appended
+// as a new path.
+bool addDawgWord(FLDawgBuilder *builder, const char *word, size_t length) {
+  std::vector<FLDawgPathState> &path = builder->path;
+  size_t lastLength = builder->pathLength - 1;
+  size_t common = 0;
+  while(common < length && common < lastLength && path[common].letters.back() == (unsigned char)word[common])
+    common++;
+  if(common == length) return false;   // empty, or a prefix of (or equal to) the last word
+  if(common < lastLength && (unsigned char)word[common] < path[common].letters.back()) return false;
+  finishDawgPath(builder, common + 1);
+  if(path.size() < length + 1)
+    path.resize(length + 1);
+  for(size_t d = common; d < length; d++) {
+    path[d].letters.push_back(word[d]);
+    path[d].targets.push_back(kDawgNoState);
+  }
+  path[length].final = true;
+  builder->pathLength = length + 1;
+  return true;
+}
+
+// finishDawg()
+// Requires:  FLDawgBuilder *
+// Returns:   FLDawg * (caller deletes)
+// Finishes the last path, root included, and returns the minimal automaton of the
+// words added, with the register and path of the builder freed.
+FLDawg *finishDawg(FLDawgBuilder *builder) {
+  FLDawg *dawg = builder->dawg;
+  finishDawgPath(builder, 1);
+  dawg->root = finishDawgState(builder, &builder->path[0]);
+  std::vector<uint64_t>().swap(builder->registry);
+  std::vector<FLDawgPathState>().swap(builder->path);
+  dawg->states.shrink_to_fit();
+  dawg->arcLetters.shrink_to_fit();
+  dawg->arcTargets.shrink_to_fit();
+  builder->dawg = NULL;
+  return dawg;
+}
+
+// buildDawgFromWords()
+// Requires:  const FLWordStorage *
+// Returns:   FLDawg * (caller deletes)
+// Builds the DAWG of every stored word, adding the word table indices sorted by their words.
+FLDawg *buildDawgFromWords(const FLWordStorage *wordStorage) {
+  std::vector<uint32_t> sortedWords(wordStorage->wordCount);
+  for(size_t i = 0; i < sortedWords.size(); i++)
+    sortedWords[i] = i;
+  FLWordIndexLess wordIndexLess = { wordStorage };
+  std::sort(sortedWords.begin(), sortedWords.end(), wordIndexLess);
+  FLDawgBuilder builder;
+  initDawgBuilder(&builder);
+  for(size_t i = 0; i < sortedWords.size(); i++) {
+    FLWordView word = storedWord(wordStorage, sortedWords[i]);
+    addDawgWord(&builder, word.data, word.length);
+  }
+  return finishDawg(&builder);
+}
+
+// dawgFindArc()
+// Requires:  const FLDawg *, uint32_t, char
+// Returns:   uint32_t
+// Returns the target of the arc of the state for the letter, or kDawgNoState.
+uint32_t dawgFindArc(const FLDawg *dawg, uint32_t state, char letter) {
+  const FLDawgState &dawgState = dawg->states[state];
+  size_t lastArc = dawgState.firstArc + (dawgState.arcCount & ~kDawgFinal);
+  for(size_t arc = dawgState.firstArc; arc < lastArc; arc++)
+    if(dawg->arcLetters[arc] >= (unsigned char)letter)
+      return dawg->arcLetters[arc] == (unsigned char)letter ? dawg->arcTargets[arc] : kDawgNoState;
+  return kDawgNoState;
+}
+
+// dawgContains()
+// Requires:  const FLDawg *, const char *, size_t
+// Returns:   bool
+// Returns true if the characters are a word of the DAWG.
+bool dawgContains(const FLDawg *dawg, const char *word, size_t length) {
+  uint32_t state = dawg->root;
+  for(size_t i = 0; i < length && state != kDawgNoState; i++)
+    state = dawgFindArc(dawg, state, word[i]);
+  return state != kDawgNoState && (dawg->states[state].arcCount & kDawgFinal) != 0;
+}
+
+// dawgPrefixSearch()
+// Requires:  const char *, size_t, size_t, FLSearchContext *, std::vector<size_t> reference
+// Returns:   None
+// As doubleArrayPrefixSearch(), with the DAWG of the context:  appends the end position
+// of every dictionary word starting at the start position (increasing) to ends.
+void dawgPrefixSearch(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+		      std::vector<size_t> &ends) {
+  const FLDawg *dawg = context->dawg;
+  uint32_t state = dawg->root;
+  context->stats.lookups++;
+  for(size_t pos = start; pos < wordLen; pos++) {
+    state = dawgFindArc(dawg, state, word[pos]);
+    if(state == kDawgNoState) break;
+    context->stats.trieNodeSteps++;
+    if(dawg->states[state].arcCount & kDawgFinal)
+      ends.push_back(pos + 1);
+  }
+}
+
+// trieWordIsMadeOfOtherWords()
+// Requires:  const char *, size_t, size_t, FLSearchContext *
+// Returns:   bool
+//
+// Trie version of wordIsMadeOfOtherWords(), testing the part of the word from
+// the start position onward.  Call with a start of 0 for a full word.
+// (1) Walk the trie (or the double array or DAWG of those engines) once from the start
+//     position, recording the end of every word along the path.  If the walk consumes
+//     the rest of the word on an end of word marker and this is not the full word,
+//     the remainder is a word.
+// (2) Greedy, as with the hash engine:  try the longest word boundary first, and
+//     test the remaining substring from that boundary recursively (through the
+//     suffix cache), falling back to the preceding end of word markers.
+// The boundaries of each call are pushed on the shared trieBoundaries vector of the
+// context and popped on return, so nested calls reuse the same storage.
+bool trieWordIsMadeOfOtherWords(const char *word, size_t wordLen, size_t start, FLSearchContext *context) {
+  FLTrie *trie = context->trie;
+  std::vector<size_t> &boundaries = context->trieBoundaries;
+  size_t firstBoundary = boundaries.size();
+
+  if(context->doubleArray != NULL)
+    doubleArrayPrefixSearch(word, wordLen, start, context, boundaries);
+  else if(context->dawg != NULL)
+    dawgPrefixSearch(word, wordLen, start, context, boundaries);
+  else {
+    int node = 0;
+    context->stats.lookups++;
+    for(size_t pos = start; pos < wordLen; pos++) {
+      node = trieFindChild(trie, node, word[pos]);
+      if(node < 0) break;
+      context->stats.trieNodeSteps++;
+      if((*trie)[node].endOfWord)
+	boundaries.push_back(pos + 1);
+    }
+  }
+  if(boundaries.size() > firstBoundary && boundaries.back() == wordLen) {
+    boundaries.pop_back();
+    if(start > 0) {
+      if(kDoDebug) printf("Match found with remaining string %.*s\n", (int)(wordLen - start), word + start);
+      boundaries.resize(firstBoundary);
+      return true;
+    }
+  }
+
+  bool result = false;
+  for(size_t i = boundaries.size(); i > firstBoundary && !result; i--) {
+    size_t boundary = boundaries[i - 1];
+    if(kDoDebug) printf("Match found with partial word %.*s, start %lu, length %lu\n",
+			(int)(boundary - start), word + start, (unsigned long)start,
+			(unsigned long)(boundary - start));
+    const char *remainingString = word + boundary;
+    size_t remlen = wordLen - boundary;
+    uint64_t remainingHash = substringHash(context, remainingString, remlen);
+    if(!suffixCacheLookup(context->suffixCache, remainingHash, remainingString, remlen, result)) {
+      enterCheckCall(context);
+      result = trieWordIsMadeOfOtherWords(word, wordLen, boundary, context);
+      context->checkDepth--;
+      suffixCacheStore(context->suffixCache, remainingHash, remainingString, remlen, result);
+    }
+  }
+  boundaries.resize(firstBoundary);
+  return result;
+}
+
+// dpWordIsMadeOfOtherWords()
+// Requires:  const char *, size_t, FLSearchContext *
+// Returns:   bool
+// Bottom-up word break over a bitset of reachable split positions (see the notes at
+// the top of the file).  Positions already reachable are not probed again, and the
+// function returns as soon as the end of the word becomes reachable.
+// The shortest and longest word lengths bound the probes from each position.
+// The bitset is the dpReachable vector of the context, reserved for the longest word.
+bool dpWordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context) {
+  std::vector<unsigned char> &reachable = context->dpReachable;
+  reachable.assign(wordLen + 1, 0);
+  reachable[0] = 1;
+
+  for(size_t pos = 0; pos < wordLen; pos++) {
+    if(!reachable[pos]) continue;
+    size_t maxLen = std::min(context->maxWordLength, wordLen - pos);
+    if(pos == 0 && maxLen == wordLen) maxLen--;   // never match the full word with itself
+    for(size_t len = context->lengthMasks->minLength; len <= maxLen; len++) {
+      if(reachable[pos + len]) continue;
+      if(dictionaryContains(context, word + pos, len)) {
+	if(kDoDebug) printf("Match found with partial word %.*s, start %lu, length %lu\n",
+			    (int)len, word + pos, (unsigned long)pos, (unsigned long)len);
+	if(pos + len == wordLen) return true;
+	reachable[pos + len] = 1;
+      }
+    }
+  }
+  return false;
+}
+
+// buildAutomatonFromWords()
+// Requires:  const FLWordStorage *
+// Returns:   FLAutomaton * (caller deletes)
+// Builds the Aho-Corasick automaton of every stored word:  the trie of the words is
+// built first (buildTrieFromWords()) and renumbered breadth first, with the children
+// of each node sorted by letter, then freed.  The failure and output links are set
+// in the same (breadth first) order, so the links of every shallower state, which
+// the failure of a state is computed from, are already set.
+FLAutomaton *buildAutomatonFromWords(const FLWordStorage *wordStorage) {
+  FLTrie *trie = buildTrieFromWords(wordStorage);
+  FLAutomaton *automaton = new FLAutomaton;
+  std::vector<FLAutomatonState> &states = automaton->states;
+  states.reserve(trie->size());
+  automaton->letters.reserve(trie->size());
+  std::vector<int> trieNodes;   // the trie node of each state, in breadth first order
+  std::vector<uint32_t> depths;
+  trieNodes.reserve(trie->size());
+  depths.reserve(trie->size());
+  FLAutomatonState rootState = { 0, 0, 0, 0, 0 };
+  states.push_back(rootState);
+  automaton->letters.push_back('\0');
+  trieNodes.push_back(0);
+  depths.push_back(0);
+
+  std::vector<std::pair<unsigned char, int> > children;
+  for(size_t state = 0; state < trieNodes.size(); state++) {
+    children.clear();
+    for(int child = (*trie)[trieNodes[state]].firstChild; child >= 0; child = (*trie)[child].nextSibling)
+      children.push_back(std::make_pair((unsigned char)(*trie)[child].letter, child));
+    std::sort(children.begin(), children.end());
+    states[state].firstChild = states.size();
+    states[state].childCount = children.size();
+    for(size_t i = 0; i < children.size(); i++) {
+      uint32_t depth = depths[state] + 1;
+      FLAutomatonState childState = { 0, 0, 0, 0, (*trie)[children[i].second].endOfWord ? depth : 0 };
+      states.push_back(childState);
+      automaton->letters.push_back(children[i].first);
+      trieNodes.push_back(children[i].second);
+      depths.push_back(depth);
+    }
+  }
+  delete trie;
+
+  for(size_t i = 0; i < 256; i++)
+    automaton->rootNext[i] = 0;
+  for(uint32_t child = states[0].firstChild; child < states[0].firstChild + states[0].childCount; child++)
+    automaton->rootNext[automaton->letters[child]] = child;
+  for(size_t state = 1; state < states.size(); state++) {
+    for(uint32_t child = states[state].firstChild; child < states[state].firstChild + states[state].childCount; child++) {
+      uint32_t fail = automatonNextState(automaton, states[state].fail, automaton->letters[child], NULL);
+      states[child].fail = fail;
+      states[child].output = states[fail].wordLength ? fail : states[fail].output;
+    }
+  }
+  return automaton;
+}
+
+// automatonNextState()
+// Requires:  const FLAutomaton *, uint32_t, unsigned char, FLSearchContext * (may be NULL)
+// Returns:   uint32_t
+// Returns the state after reading the letter:  the child for the letter of the state,
+// or of the first state on its failure chain that has one (the root if none does).
+// The steps taken are counted as trie node steps in the context, if given.
+uint32_t automatonNextState(const FLAutomaton *automaton, uint32_t state, unsigned char letter,
+			    FLSearchContext *context) {
+  const unsigned char *letters = automaton->letters.data();
+  for(;;) {
+    if(context != NULL) context->stats.trieNodeSteps++;
+    if(state == 0) return automaton->rootNext[letter];
+    const FLAutomatonState &current = automaton->states[state];
+    for(uint32_t child = current.firstChild; child < current.firstChild + current.childCount; child++) {
+      if(letters[child] == letter) return child;
+      if(letters[child] > letter) break;
+    }
+    state = current.fail;
+  }
+}
+
+// acWordIsMadeOfOtherWords()
+// Requires:  const char *, size_t, FLSearchContext *
+// Returns:   bool
+// Aho-Corasick version of the word break (see the notes at the top of the file):
+// scans the word once, and at each position follows the output links of the state
+// through the words ending there, marking the position reachable as soon as one of
+// them starts at a reachable position.  Returns true once the end of the word is
+// reachable (by a split, never by the word itself).
+// The bitset is the dpReachable vector of the context, reserved for the longest word.
+bool acWordIsMadeOfOtherWords(const char *word, size_t wordLen, FLSearchContext *context) {
+  const FLAutomaton *automaton = context->automaton;
+  const FLAutomatonState *states = automaton->states.data();
+  std::vector<unsigned char> &reachable = context->dpReachable;
+  reachable.assign(wordLen + 1, 0);
+  reachable[0] = 1;
+  context->stats.lookups++;
+
+  uint32_t state = 0;
+  for(size_t end = 1; end <= wordLen; end++) {
+    state = automatonNextState(automaton, state, word[end - 1], context);
+    uint32_t match = states[state].wordLength ? state : states[state].output;
+    for(; match != 0; match = states[match].output) {
+      size_t start = end - states[match].wordLength;
+      if(reachable[start] && !(start == 0 && end == wordLen)) {
+	if(kDoDebug) printf("Match found with partial word %.*s, start %lu, length %lu\n",
+			    (int)(end - start), word + start, (unsigned long)start, (unsigned long)(end - start));
+	reachable[end] = 1;
+	break;
+      }
+    }
+  }
+  return reachable[wordLen];
+}
+
+// findAutomatonEdges()
+// Requires:  const char *, size_t, FLSearchContext *, FLSegmentation *
+// Returns:   None
+// Segmentation with the ac engine (see segmentWord()):  scans the word once and adds
+// the split counts along every word occurrence, in increasing end order (the counts
+// of its start are final by then), keeping the occurrences that start at a reachable
+// position as edges, then sorts the edges by start.
+void findAutomatonEdges(const char *word, size_t wordLen, FLSearchContext *context,
+			FLSegmentation *segmentation) {
+  const FLAutomaton *automaton = context->automaton;
+  const FLAutomatonState *states = automaton->states.data();
+  std::vector<uint64_t> &pathCounts = segmentation->pathCounts;
+  context->stats.lookups++;
+  uint32_t state = 0;
+  for(size_t end = 1; end <= wordLen; end++) {
+    state = automatonNextState(automaton, state, word[end - 1], context);
+    uint32_t match = states[state].wordLength ? state : states[state].output;
+    for(; match != 0; match = states[match].output) {
+      size_t start = end - states[match].wordLength;
+      if(pathCounts[start] == 0 || (start == 0 && end == wordLen)) continue;
+      segmentation->edges.push_back(std::make_pair((uint32_t)start, (uint32_t)end));
+      uint64_t &count = pathCounts[end];
+      if(count > UINT64_MAX - pathCounts[start]) {
+	count = UINT64_MAX;
+	segmentation->saturated = true;
+      } else
+	count += pathCounts[start];
+    }
+  }
+  std::sort(segmentation->edges.begin(), segmentation->edges.end());
+}
+
+// enterCheckCall()
+// Requires:  FLSearchContext *
+// Returns:   None
+// Counts a call of the checker and its nesting depth; the caller decrements
+// checkDepth of the context when the call returns.
+void enterCheckCall(FLSearchContext *context) {
+  context->stats.checkCalls++;
+  if(++context->checkDepth > context->stats.maxCheckDepth)
+    context->stats.maxCheckDepth = context->checkDepth;
+}
+
+// checkWord()
+// Requires:  const FLWordView reference, FLSearchContext *
+// Returns:   bool
+// Hashes the prefixes of the word, tests whether the word is made of other words with
+// the engine selected by kEngine, and records the largest number of lookups made for
+// a single word and the histogram of lookups per word.
+bool checkWord(const FLWordView &word, FLSearchContext *context) {
+  FLSearchStats &stats = context->stats;
+  unsigned long lookupsBefore = stats.lookups;
+  bool result;
+  hashCheckedWord(context, word.data, word.length);
+  enterCheckCall(context);
+  if(kEngine == kEngineTrie || kEngine == kEngineDoubleArray || kEngine == kEngineDawg)
+    result = trieWordIsMadeOfOtherWords(word.data, word.length, 0, context);
+  else if(kEngine == kEngineDP)
+    result = dpWordIsMadeOfOtherWords(word.data, word.length, context);
+  else if(kEngine == kEngineAC)
+    result = acWordIsMadeOfOtherWords(word.data, word.length, context);
+  else
+    result = wordIsMadeOfOtherWords(word.data, word.length, context);
+  context->checkDepth--;
+  context->hashedWord = NULL;
+
+  unsigned long wordLookups = stats.lookups - lookupsBefore;
+  if(wordLookups > stats.maxLookupsPerWord)
+    stats.maxLookupsPerWord = wordLookups;
+  size_t bucket = 0;
+  for(unsigned long n = wordLookups; n > 0 && bucket + 1 < kLookupHistogramBuckets; n >>= 1)
+    bucket++;
+  stats.lookupHistogram[bucket]++;
+  stats.wordsTested++;
+  return result;
+}
+
+// checkWordWithAlert()
+// Requires:  const FLWordView reference, FLSearchContext *
+// Returns:   bool
+// Calls checkWord().  If kAlertMicros is set, the check is timed, and a word
+// over the limit is reported and counted.
+bool checkWordWithAlert(const FLWordView &word, FLSearchContext *context) {
+  if(kAlertMicros <= 0)
+    return checkWord(word, context);
+
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  bool result = checkWord(word, context);
+  long elapsedMicros = std::chrono::duration_cast<std::chrono::microseconds>
+    (std::chrono::steady_clock::now() - startTime).count();
+  if(elapsedMicros > kAlertMicros) {
+    context->stats.alerts++;
+    printf("ALERT:  Word %.*s took %ld us to check.\n", (int)word.length, word.data, elapsedMicros);
+  }
+  return result;
+}
+
+// addSearchStats()
+// Requires:  FLSearchStats *, FLSearchStats *
+// Returns:   None
+// Adds one set of search counters (a search thread's) to a total; the per word
+// and depth maximums are merged as maximums.
+void addSearchStats(FLSearchStats *total, FLSearchStats *part) {
+  total->wordsTested += part->wordsTested;
+  total->lookups += part->lookups;
+  total->hashedChars += part->hashedChars;
+  total->trieNodeSteps += part->trieNodeSteps;
+  total->maxLookupsPerWord = std::max(total->maxLookupsPerWord, part->maxLookupsPerWord);
+  total->checkCalls += part->checkCalls;
+  total->maxCheckDepth = std::max(total->maxCheckDepth, part->maxCheckDepth);
+  total->alerts += part->alerts;
+  total->allocations += part->allocations;
+  total->bloomNegatives += part->bloomNegatives;
+  total->bloomFalsePositives += part->bloomFalsePositives;
+  total->lengthSkips += part->lengthSkips;
+  for(size_t i = 0; i < kLookupHistogramBuckets; i++)
+    total->lookupHistogram[i] += part->lookupHistogram[i];
+}
+
+// sizeHashSortFunction()
+// Requires:  const FLWordView reference, const FLWordView reference
+// Returns:   bool
+// The function compares the characters of two word views.
+// Used for std::sort() with iterators for a vector of FLWordView.
+// std::sort() expects a boolean result of (a < b), not the integer results
+// of (<0, 0, or >0) supplied by string.compare() or memcmp().
+// Views in one vector have equal lengths, but ties on the common prefix
+// still fall back to the shorter view first.
+bool sizeHashSortFunction(const FLWordView &a, const FLWordView &b) {
+  int result = memcmp(a.data, b.data, std::min(a.length, b.length));
+  return (result < 0) || (result == 0 && a.length < b.length);
+}
+
+// FLWordIndexLess::operator()()
+// Requires:  uint32_t, uint32_t
+// Returns:   bool
+// Compares the stored words at two word table indices with sizeHashSortFunction(),
+// for std::sort() of the index vectors in the length map.
+bool FLWordIndexLess::operator()(uint32_t a, uint32_t b) const {
+  return sizeHashSortFunction(storedWord(wordStorage, a), storedWord(wordStorage, b));
+}
+
+// FLCompoundOrder::operator()()
+// Requires:  uint32_t, uint32_t
+// Returns:   bool
+// Orders two word table indices longest word first, then as the words of a length
+// bucket are searched:  by their characters with -s (kDoPreSort), by index (the load
+// order) otherwise.
+bool FLCompoundOrder::operator()(uint32_t a, uint32_t b) const {
+  FLWordView wordA = storedWord(wordStorage, a), wordB = storedWord(wordStorage, b);
+  if(wordA.length != wordB.length) return wordA.length > wordB.length;
+  if(kDoPreSort) return sizeHashSortFunction(wordA, wordB);
+  return a < b;
+}
+
+
+// extractAndSortKeysFromSizeHash()
+// Requires:  FLLengthMap *, const FLWordStorage *, std::vector<int> reference (should be empty)
+// Returns:   None
+// The function pulls the (key, value) pairs from the string size hash, where the
+// keys are integer string lengths and the values are vectors of word table indices.
+// It adds the integer string lengths (keys) to the empty provided vector reference.
+// -- It optionally sorts the vectors of indices by their stored words if requested
+//    by the command line option, unless --stream found the input sorted (then the
+//    vectors, in load order, are already sorted).
+// It finally sorts the vector of integer key lengths.
+void extractAndSortKeysFromSizeHash(FLLengthMap *sizeHash, const FLWordStorage *wordStorage,
+				    std::vector<int> &keyVector) {
+  FLWordIndexLess wordIndexLess = { wordStorage };
+  for(auto sizeHashIter = sizeHash->begin(); sizeHashIter != sizeHash->end(); ++sizeHashIter) {
+    keyVector.push_back(sizeHashIter->first);
+    if(kDoPreSort && !gLoadStats.sortedInput) std::sort((sizeHashIter->second).begin(), (sizeHashIter->second).end(),
+    			     wordIndexLess);
+  }
+  std::sort(keyVector.begin(), keyVector.end());
+}
+
+// longestWordLength()
+// Requires:  FLLengthMap *
+// Returns:   size_t
+// Returns the largest string length key in the size hash (0 if empty).
+size_t longestWordLength(FLLengthMap *sizeHash) {
+  size_t longest = 0;
+  for(auto sizeHashIter = sizeHash->begin(); sizeHashIter != sizeHash->end(); ++sizeHashIter)
+    longest = std::max(longest, sizeHashIter->first);
+  return longest;
+}
+
+// searchWordChunks()
+// Requires:  const std::vector<uint32_t> *, std::atomic<size_t> *, std::atomic<size_t> *,
+//            FLSearchWorker *
+// Returns:   None
+// Search thread loop:  claims the next chunk of kSearchChunkWords words from the
+// shared cursor until the ordered list is exhausted, and checks each word with the
+// worker's own context.  Threads that finish a chunk of quick (short) words simply
+// claim more, so the buckets balance across threads without a lock.
+// The worker keeps its count and the kTopCount smallest list positions of its compounds.
+// Without the count, once a worker holds kTopCount positions, no word past the largest
+// of them can be in the result, so it lowers the shared stop index to that position;
+// all threads stop checking words past the stop index.
+// The allocations of the thread are added to the stats of the worker's context.
+void searchWordChunks(const std::vector<uint32_t> *orderedWords, std::atomic<size_t> *nextChunk,
+		      std::atomic<size_t> *stopIndex, FLSearchWorker *worker) {
+  const FLWordStorage *wordStorage = worker->context.wordStorage;
+  size_t wordCount = orderedWords->size();
+  std::vector<size_t> &topIndices = worker->topIndices;
+  unsigned long allocationsBefore = gAllocationCount;
+  bool stopped = false;
+  size_t chunkStart;
+  while(!stopped && (chunkStart = nextChunk->fetch_add(1, std::memory_order_relaxed) * kSearchChunkWords) < wordCount) {
+    size_t chunkEnd = std::min(chunkStart + kSearchChunkWords, wordCount);
+    for(size_t wordIndex = chunkStart; wordIndex < chunkEnd; wordIndex++) {
+      if(wordIndex > stopIndex->load(std::memory_order_relaxed)) {
+	stopped = true;
+	break;
+      }
+      if(!checkWordWithAlert(storedWord(wordStorage, (*orderedWords)[wordIndex]), &worker->context)) continue;
+      worker->countFound++;
+      if(topIndices.size() == kTopCount && wordIndex > topIndices.back()) continue;
+      // Chunks are claimed in order, but a thread's positions still need a sorted insert.
+      topIndices.insert(std::upper_bound(topIndices.begin(), topIndices.end(), wordIndex), wordIndex);
+      if(topIndices.size() > kTopCount) topIndices.pop_back();
+      if(!kDoCount && topIndices.size() == kTopCount) {
+	size_t bound = topIndices.back();
+	size_t current = stopIndex->load();
+	while(bound < current && !stopIndex->compare_exchange_weak(current, bound)) {}
+      }
+    }
+  }
+  worker->context.stats.allocations += gAllocationCount - allocationsBefore;
+}
+
+// findLongestWordsOfWordsParallel()
+// Requires:  FLSearchContext *, FLLengthMap *, std::vector<int> reference (sorted keys),
+//            std::vector<std::string> reference
+// Returns:   int
+// Parallel version of the loop in findLongestWordsOfWords(), using kThreadCount threads.
+// (1) Flatten the length map into one list of word table indices in the sequential
+//     order (longest bucket first, words in bucket order).
+// (2) Give each thread its own context and an equal share of the suffix cache budget,
+//     sharing the read only dictionary structures of the provided context.
+// (3) Run searchWordChunks() on each thread; the threads only share the chunk cursor
+//     and the stop index.
+// (4) After joining, sum the counts and keep the kTopCount smallest list positions over
+//     all threads; those are the words the sequential loop would find first.
+// Counters of the threads and their caches are added to the provided context.
+int findLongestWordsOfWordsParallel(FLSearchContext *context, FLLengthMap *sizeHash, std::vector<int> &keyList,
+				    std::vector<std::string> &topWords) {
+  std::vector<uint32_t> orderedWords;
+  orderedWords.reserve(context->wordStorage->wordCount);
+  for(int keyListIndex = keyList.size() - 1; keyListIndex >= 0; keyListIndex--) {
+    std::vector<uint32_t> &wordList = (*sizeHash)[keyList[keyListIndex]];
+    orderedWords.insert(orderedWords.end(), wordList.begin(), wordList.end());
+  }
+
+  size_t wordCount = orderedWords.size();
+  std::vector<FLSearchWorker> workers(kThreadCount);
+  for(int i = 0; i < kThreadCount; i++) {
+    FLSearchWorker &worker = workers[i];
+    initSuffixCache(&worker.suffixCache, (kSuffixCacheMB << 20) / kThreadCount, wordCount);
+    initSearchContext(&worker.context, context->wordStorage, context->stringSet, context->flatSet,
+		      context->trie, context->automaton, context->doubleArray, context->dawg,
+		      context->bloomFilter, context->lengthMasks, &worker.suffixCache, context->maxWordLength);
+    worker.topIndices.reserve(kTopCount + 1);
+    worker.countFound = 0;
+  }
+
+  std::atomic<size_t> nextChunk(0);
+  std::atomic<size_t> stopIndex(SIZE_MAX);
+  std::vector<std::thread> threads;
+  threads.reserve(kThreadCount);
+  for(int i = 0; i < kThreadCount; i++)
+    threads.push_back(std::thread(searchWordChunks, &orderedWords, &nextChunk, &stopIndex, &workers[i]));
+  for(int i = 0; i < kThreadCount; i++)
+    threads[i].join();
+
+  int countFound = 0;
+  std::vector<size_t> topIndices;
+  for(int i = 0; i < kThreadCount; i++) {
+    FLSearchWorker &worker = workers[i];
+    countFound += worker.countFound;
+    topIndices.insert(topIndices.end(), worker.topIndices.begin(), worker.topIndices.end());
+    addSearchStats(&context->stats, &worker.context.stats);
+    if(context->suffixCache != NULL)
+      addSuffixCacheCounters(context->suffixCache, &worker.suffixCache);
+  }
+  std::sort(topIndices.begin(), topIndices.end());
+  if(topIndices.size() > kTopCount) topIndices.resize(kTopCount);
+
+  topWords.clear();
+  for(size_t i = 0; i < topIndices.size(); i++) {
+    FLWordView word = storedWord(context->wordStorage, orderedWords[topIndices[i]]);
+    topWords.push_back(std::string(word.data, word.length));
+  }
+  return countFound;
+}
+
+// findLongestWordsOfWords()
+// Requires:  FLSearchContext *, FLLengthMap *, std::vector<std::string> reference
+// Returns:   int
+// The function takes pointers to a search context (word storage, and the populated store or
+// FLTrie for the selected engine) and a populated FLLengthMap, and a reference to a vector for the
+// requested longest words made of other words (kTopCount of them; first and second by default).
+// (1) It extracts and sorts the string length keys (number should be <= longest words)
+//     from the FLLengthMap, and initializes a loop counter to start with the largest key.
+// (2) While the key index is in range:
+//     (2a) Get a pointer to the vector of word table indices at the key index
+//     (2b) Get the size of the vector and initialize a loop counter (word index)
+//     (2c) While the word index is in range:
+//          (2d) Get a view of the stored word at the word index and check if it is made of other words
+//               If match:  increment count of found words of other words, and potentially
+//                          store word in the provided vector, if it holds fewer than
+//                          kTopCount words.
+//               If not counting (--no-count), stop once kTopCount words are stored.
+// If kAlertMicros is set, each check is timed, and words over the limit are reported.
+// The longest words are kept as views until the loop ends, so the loop itself
+// makes no allocations; the context stats record the count to confirm it.
+// The key sort and the search are timed as the sort and search phases.
+// With more than one thread (-j), the words are checked by
+// findLongestWordsOfWordsParallel() instead, with the same results.
+// The function returns the final count of words made of other words in the string set
+// (only the words found before stopping, when not counting).
+int findLongestWordsOfWords(FLSearchContext *context, FLLengthMap *sizeHash, std::vector<std::string> &topWords) {
+  std::vector<FLWordView> topViews;
+  topViews.reserve(kTopCount);
+  bool searchDone = false;
+  int countFound = 0;
+
+  FLPhaseClock phaseClock;
+  startPhase(&phaseClock);
+  std::vector<int> keyList;
+  extractAndSortKeysFromSizeHash(sizeHash, context->wordStorage, keyList);
+  endPhase(&phaseClock, kPhaseSort);
+  startPhase(&phaseClock);
+  if(kThreadCount > 1) {
+    countFound = findLongestWordsOfWordsParallel(context, sizeHash, keyList, topWords);
+    endPhase(&phaseClock, kPhaseSearch);
+    return countFound;
+  }
+  unsigned long allocationsBefore = gAllocationCount;
+
+  int keyListIndex, listLength, wordListIndex;
+  for(keyListIndex = keyList.size() - 1; keyListIndex >= 0 && !searchDone; keyListIndex--) {
+    std::vector<uint32_t> *wordList = &(*sizeHash)[keyList[keyListIndex]];
+    listLength = wordList->size();
+
+    for(wordListIndex = 0; wordListIndex < listLength && !searchDone; wordListIndex++) {
+      FLWordView word = storedWord(context->wordStorage, (*wordList)[wordListIndex]);
+      if(kDoDebug) printf("Trying word %.*s\n", (int)word.length, word.data);
+      //      if(wordIsMadeOfOtherWords(*word, stringSet, 0)) {     // no longer need call level
+      if(checkWordWithAlert(word, context)) {
+	if(kDoDebug) printf("Word %.*s is made of other words.\n", (int)word.length, word.data);
+	countFound++;
+	if(topViews.size() < kTopCount) {
+	  topViews.push_back(word);
+	  searchDone = (!kDoCount && topViews.size() == kTopCount);
+	}
+      }
+    }
+  }
+  context->stats.allocations += gAllocationCount - allocationsBefore;
+  topWords.clear();
+  for(size_t i = 0; i < topViews.size(); i++)
+    topWords.push_back(std::string(topViews[i].data, topViews[i].length));
+  endPhase(&phaseClock, kPhaseSearch);
+  return countFound;
+}
+
+// findSegmentEdges()
+// Requires:  const char *, size_t, size_t, FLSearchContext *, FLSegmentation *
+// Returns:   None
+// Appends the edges starting at the position to the segmentation:  every dictionary
+// word at the start of the rest of the word, except the whole word.  The trie,
+// double-array, and dawg engines find them in one walk; the stores probe each length
+// up to the longest word.
+void findSegmentEdges(const char *word, size_t wordLen, size_t start, FLSearchContext *context,
+		      FLSegmentation *segmentation) {
+  size_t maxLen = std::min(context->maxWordLength, wordLen - start);
+  if(start == 0 && maxLen == wordLen) maxLen--;   // never match the full word with itself
+  if(context->doubleArray != NULL || context->dawg != NULL) {
+    std::vector<size_t> &ends = context->trieBoundaries;
+    ends.clear();
+    if(context->doubleArray != NULL)
+      doubleArrayPrefixSearch(word, wordLen, start, context, ends);
+    else
+      dawgPrefixSearch(word, wordLen, start, context, ends);
+    for(size_t i = 0; i < ends.size() && ends[i] - start <= maxLen; i++)
+      segmentation->edges.push_back(std::make_pair((uint32_t)start, (uint32_t)ends[i]));
+    return;
+  }
+  if(context->trie != NULL) {
+    FLTrie *trie = context->trie;
+    int node = 0;
+    context->stats.lookups++;
+    for(size_t len = 1; len <= maxLen; len++) {
+      node = trieFindChild(trie, node, word[start + len - 1]);
+      if(node < 0) break;
+      context->stats.trieNodeSteps++;
+      if((*trie)[node].endOfWord)
+	segmentation->edges.push_back(std::make_pair((uint32_t)start, (uint32_t)(start + len)));
+    }
+    return;
+  }
+  for(size_t len = context->lengthMasks->minLength; len <= maxLen; len++)
+    if(dictionaryContains(context, word + start, len))
+      segmentation->edges.push_back(std::make_pair((uint32_t)start, (uint32_t)(start + len)));
+}
+
+// segmentWord()
+// Requires:  const FLWordView reference, FLSearchContext *, FLSegmentation *
+// Returns:   uint64_t
+// Builds the segmentation DAG of the word and returns its number of decompositions
+// (0 if it is not made of other words; UINT64_MAX, with saturated set, if there are
+// at least that many).  The edges from each position reachable from the start are
+// found once, left to right, while the split counts are added up along them (the
+// word-break dynamic program, counting instead of stopping at the first split), so
+// the cost is that of the dp engine on the word, however many decompositions there
+// are.  (With the ac engine, findAutomatonEdges() does this in one scan instead.)
+// A backward pass over the edges then keeps only those that reach the end, and the
+// positions they join.
+uint64_t segmentWord(const FLWordView &word, FLSearchContext *context, FLSegmentation *segmentation) {
+  std::vector<uint64_t> &pathCounts = segmentation->pathCounts;
+  std::vector<unsigned char> &reachesEnd = segmentation->reachesEnd;
+  std::vector<std::pair<uint32_t, uint32_t> > &edges = segmentation->edges;
+  size_t wordLen = word.length;
+  pathCounts.assign(wordLen + 1, 0);
+  pathCounts[0] = 1;
+  edges.clear();
+  segmentation->positions.clear();
+  segmentation->saturated = false;
+  hashCheckedWord(context, word.data, wordLen);
+
+  if(context->automaton != NULL)
+    findAutomatonEdges(word.data, wordLen, context, segmentation);
+  for(size_t pos = 0; pos < wordLen && context->automaton == NULL; pos++) {
+    if(pathCounts[pos] == 0) continue;
+    size_t firstEdge = edges.size();
+    findSegmentEdges(word.data, wordLen, pos, context, segmentation);
+    for(size_t i = firstEdge; i < edges.size(); i++) {
+      uint64_t &count = pathCounts[edges[i].second];
+      if(count > UINT64_MAX - pathCounts[pos]) {
+	count = UINT64_MAX;
+	segmentation->saturated = true;
+      } else
+	count += pathCounts[pos];
+    }
+  }
+  context->hashedWord = NULL;
+  if(pathCounts[wordLen] == 0) return 0;
+
+  // Edges are in increasing start order, so a backward pass sees each end before its start.
+  reachesEnd.assign(wordLen + 1, 0);
+  reachesEnd[wordLen] = 1;
+  size_t keptEdges = edges.size();
+  for(size_t i = edges.size(); i > 0; i--) {
+    if(!reachesEnd[edges[i - 1].second]) continue;
+    reachesEnd[edges[i - 1].first] = 1;
+    edges[--keptEdges] = edges[i - 1];
+  }
+  edges.erase(edges.begin(), edges.begin() + keptEdges);
+  for(size_t pos = 0; pos <= wordLen; pos++)
+    if(reachesEnd[pos] && pathCounts[pos] > 0)
+      segmentation->positions.push_back(pos);
+  return pathCounts[wordLen];
+}
+
+// printSegmentations()
+// Requires:  FLSearchContext *, FLLengthMap *
+// Returns:   int
+// Segmentation mode (--segments):  prints one line per compound, in search order
+// (longest first, then in length bucket order), with its number of decompositions,
+// the split positions, and the edges of its segmentation DAG as start-end pairs:
+//   segments word=catsdogcats count=2 positions=0,3,4,7,8,11 edges=0-3,0-4,3-7,...
+// A count of 18446744073709551615 followed by "+" is saturated.  Every split is a
+// path from position 0 to the end along the edges, so the DAG lists them all without
+// enumerating them.  The lookups are made with a context of their own, so the search
+// counters only count the search.  Returns the number of compounds printed.
+int printSegmentations(FLSearchContext *context, FLLengthMap *sizeHash) {
+  FLSearchContext segmentContext;
+  initSearchContext(&segmentContext, context->wordStorage, context->stringSet, context->flatSet,
+		    context->trie, context->automaton, context->doubleArray, context->dawg, context->bloomFilter,
+		    context->lengthMasks, NULL, context->maxWordLength);
+  FLSegmentation segmentation;
+  segmentation.pathCounts.reserve(context->maxWordLength + 1);
+  segmentation.reachesEnd.reserve(context->maxWordLength + 1);
+  std::vector<int> keyList;
+  extractAndSortKeysFromSizeHash(sizeHash, context->wordStorage, keyList);
+
+  int countPrinted = 0;
+  std::string line;
+  for(int keyListIndex = keyList.size() - 1; keyListIndex >= 0; keyListIndex--) {
+    std::vector<uint32_t> &wordList = (*sizeHash)[keyList[keyListIndex]];
+    for(size_t i = 0; i < wordList.size(); i++) {
+      FLWordView word = storedWord(context->wordStorage, wordList[i]);
+      uint64_t count = segmentWord(word, &segmentContext, &segmentation);
+      if(count == 0) continue;
+      countPrinted++;
+      line.assign("segments word=");
+      line.append(word.data, word.length);
+      line += " count=" + std::to_string(count) + (segmentation.saturated ? "+" : "") + " positions=";
+      for(size_t j = 0; j < segmentation.positions.size(); j++)
+	line += (j ? "," : "") + std::to_string(segmentation.positions[j]);
+      line += " edges=";
+      for(size_t j = 0; j < segmentation.edges.size(); j++)
+	line += (j ? "," : "") + std::to_string(segmentation.edges[j].first) + '-' +
+	  std::to_string(segmentation.edges[j].second);
+      puts(line.c_str());
+    }
+  }
+  return countPrinted;
+}
+
+// newWordStorage()
+// Requires:  None
+// Returns:   FLWordStorage * (caller deletes with deleteWordStorage())
+// Returns a new empty word storage, without a mapping.
+FLWordStorage *newWordStorage() {
+  FLWordStorage *wordStorage = new FLWordStorage;
+  wordStorage->mappedData = NULL;
+  wordStorage->mappedLength = 0;
+  wordStorage->entries = NULL;
+  wordStorage->wordCount = 0;
+  return wordStorage;
+}
+
+// streamDawgWord()
+// Requires:  const FLWordView reference, unsigned long
+// Returns:   None
+// Adds a newly loaded word, from the given line, to the DAWG the loaders build with
+// --stream, while it is still built.  Sorted words go straight into the automaton,
+// with only the path of the last word unfinished (see FLDawgBuilder).  The first
+// word out of order (not after the word before it) ends the stream:  its line is
+// recorded in the load stats and the partial automaton is dropped, so that main()
+// builds the DAWG from the sorted words once they are loaded.
+void streamDawgWord(const FLWordView &word, unsigned long lineNumber) {
+  if(gDawgStream == NULL || addDawgWord(gDawgStream, word.data, word.length)) return;
+  if(kDoDebug) printf("Word %.*s on line %lu is out of order; the DAWG will be built after loading\n",
+		      (int)word.length, word.data, lineNumber);
+  gLoadStats.firstUnsortedLine = lineNumber;
+  delete gDawgStream->dawg;
+  gDawgStream->dawg = NULL;
+  std::vector<uint64_t>().swap(gDawgStream->registry);
+  std::vector<FLDawgPathState>().swap(gDawgStream->path);
+  gDawgStream = NULL;
+}
+
+// addWordToHashes()
+// Requires:  const FLWordView reference, FLLengthMap *, FLFlatSet *, FLWordStorage *
+// Returns:   bool
+// Interns a cleaned, non-empty word:  unless the flat set already holds it, the word
+// is appended to the arena of the storage (or, if the storage is a file mapping,
+// left where it is in the mapping), its entry is added to the word table, and its
+// table index to the flat set and to the vector in the length map keyed by the length
+// of the word.  A duplicate word (e.g. "Cat" and "cat" after cleaning) is dropped,
+// counted in the load stats, and returns false, as does a word over kMaxWordChars
+// characters (with an error).  More than 2^32 - 1 words cause an immediate exit.
+// A word loaded is also passed to streamDawgWord() (with the line count as its line).
+bool addWordToHashes(const FLWordView &word, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		     FLWordStorage *wordStorage) {
+  //  if(kDoDebug) printf("Adding word %.*s of length %lu\n", (int)word.length, word.data, word.length);
+  uint64_t hash = hashWordChars(word.data, word.length);
+  if(flatSetContainsHash(flatSet, hash, word.data, word.length)) {
+    if(kDoDebug) printf("Dropping duplicate word %.*s\n", (int)word.length, word.data);
+    gLoadStats.duplicatesDropped++;
+    return false;
+  }
+  if(word.length > kMaxWordChars) {
+    printf("ERROR:  Skipping a word of %lu characters (the limit is %lu).\n",
+	   (unsigned long)word.length, (unsigned long)kMaxWordChars);
+    return false;
+  }
+  if(wordStorage->wordCount >= UINT32_MAX) {
+    printf("ERROR:  Too many words in the input file.\n");
+    exit(1);
+  }
+
+  size_t offset;
+  if(wordStorage->mappedData != NULL)
+    offset = word.data - wordStorage->mappedData;
+  else {
+    offset = wordStorage->arena.size();
+    wordStorage->arena.insert(wordStorage->arena.end(), word.data, word.data + word.length);
+  }
+  uint32_t wordIndex = wordStorage->wordCount;
+  wordStorage->words.push_back((FLWordEntry)offset << 24 | word.length);
+  wordStorage->entries = wordStorage->words.data();
+  wordStorage->wordCount = wordStorage->words.size();
+  flatSetInsert(flatSet, hash, wordIndex);
+  // NOTE:  STL hash creates new vectors automatically when using [] operator with an unknown key.
+  (*sizeHash)[word.length].push_back(wordIndex);
+  gLoadStats.wordsLoaded++;
+  streamDawgWord(word, gLoadStats.linesRead);
+  return true;
+}
+
+// hashStringFile()
+// Requires:  std::string reference, FLLengthMap **, FLFlatSet **, FLWordStorage **
+// Returns:   bool
+// The function takes a string reference to a file name and attempts to open
+// the file.  Failure causes an immediate exit.
+// On success, it initializes the provided double pointers with a new empty
+// flat set, length map (hash), and word storage, whose arena is reserved for the
+// size of the file.  The file is read in blocks of kIngestBlockBytes into one buffer,
+// and each block is lower cased with the ingest kernel.  Each line is found with the
+// ingest kernel, trimmed in the buffer (together, the same "cleaning" as cleanWord()),
+// and measured.  A line cut by the end of a block is moved to the front of the buffer
+// and finished by the next read.  It interns a non-empty word
+// in the word storage, the flat set, and the length map with addWordToHashes().
+// With --stats, the cleaning is timed.
+// With -j N (N > 1), the threads instead read equal parts of the file into one
+// anonymous mapping with pread(), and load it with loadTextParallel().
+// Returns true once the whole file is loaded.
+bool hashStringFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		    FLWordStorage **wordStorage) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if(fileDescriptor < 0 || fstat(fileDescriptor, &fileStat) != 0) {
+    printf("ERROR:  Couldn't open file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+  *sizeHash = new FLLengthMap;
+  *wordStorage = newWordStorage();
+  *flatSet = new FLFlatSet;
+  initFlatSet(*flatSet, *wordStorage, 0);
+  if(kThreadCount > 1 && fileStat.st_size > 0) {
+    // Parallel load:  the threads read their parts of the file into an anonymous
+    // mapping, which then serves as the word storage's mapping.
+    size_t fileLength = fileStat.st_size;
+    void *mapping = mmap(NULL, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mapping == MAP_FAILED) {
+      printf("ERROR:  Couldn't allocate %lu bytes for file %s.\n", (unsigned long)fileLength, fileName.c_str());
+      exit(1);
+    }
+    (*wordStorage)->mappedData = (char *)mapping;
+    (*wordStorage)->mappedLength = fileLength;
+    FLLoadJob job;
+    job.text = (char *)mapping;
+    job.textLength = fileLength;
+    job.fileDescriptor = fileDescriptor;
+    job.workers.resize(kThreadCount);
+    runLoadStep(&job, readLoadChunk);
+    close(fileDescriptor);
+    for(size_t i = 0; i < job.workers.size(); i++) {
+      if(job.workers[i].readFailed) {
+	printf("ERROR:  Couldn't read file %s.\n", fileName.c_str());
+	exit(1);
+      }
+    }
+    loadTextParallel(&job, *sizeHash, *flatSet, *wordStorage);
+    return true;
+  }
+  (*wordStorage)->arena.reserve(fileStat.st_size);
+
+  std::vector<char> buffer(kIngestBlockBytes);
+  size_t filled = 0;
+  bool atEnd = false;
+  while(!atEnd) {
+    ssize_t readLength = read(fileDescriptor, buffer.data() + filled, buffer.size() - filled);
+    if(readLength < 0) {
+      printf("ERROR:  Couldn't read file %s.\n", fileName.c_str());
+      exit(1);
+    }
+    atEnd = (readLength == 0);
+    if(kDoStats) {
+      std::chrono::steady_clock::time_point cleanStart = std::chrono::steady_clock::now();
+      gLowerInPlace(buffer.data() + filled, readLength);
+      gLoadStats.cleanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now()
+							       - cleanStart).count();
+    } else
+      gLowerInPlace(buffer.data() + filled, readLength);
+    filled += readLength;
+    char *lineStart = buffer.data();
+    char *dataEnd = lineStart + filled;
+    while(lineStart < dataEnd) {
+      char *lineEnd = (char *)gFindNewline(lineStart, dataEnd);
+      if(lineEnd == dataEnd && !atEnd) break;
+      char *word = lineStart;
+      size_t wordLen;
+      gLoadStats.linesRead++;
+      if(kDoStats) {
+	std::chrono::steady_clock::time_point cleanStart = std::chrono::steady_clock::now();
+	wordLen = trimLineInPlace(word, lineEnd - lineStart);
+	gLoadStats.cleanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now()
+								 - cleanStart).count();
+      } else
+	wordLen = trimLineInPlace(word, lineEnd - lineStart);
+      if(wordLen > 0)
+	addWordToHashes(FLWordView{ word, wordLen }, *sizeHash, *flatSet, *wordStorage);
+      lineStart = lineEnd + 1;
+    }
+    filled = (lineStart < dataEnd) ? dataEnd - lineStart : 0;
+    memmove(buffer.data(), lineStart, filled);
+    if(filled == buffer.size())
+      buffer.resize(2 * buffer.size());
+  }
+  close(fileDescriptor);
+  return true;
+}
+
+// mapStringFile()
+// Requires:  std::string reference, FLLengthMap **, FLFlatSet **, FLWordStorage **
+// Returns:   bool
+// Memory mapped alternative to hashStringFile() with the same results.
+// The function maps the whole file privately (copy on write), so words can be
+// cleaned in place without changing the file.  Failure to open or map the file
+// causes an immediate exit.  The mapping is loaded with loadMappedLines(), or with
+// loadTextParallel() for -j N (N > 1); the word table entries are offsets into the
+// mapping, which stays alive in the word storage until deleteWordStorage().
+// Returns true once the whole file is loaded.
+bool mapStringFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		   FLWordStorage **wordStorage) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if(fileDescriptor < 0 || fstat(fileDescriptor, &fileStat) != 0) {
+    printf("ERROR:  Couldn't open file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+  *sizeHash = new FLLengthMap;
+  *wordStorage = newWordStorage();
+  *flatSet = new FLFlatSet;
+  initFlatSet(*flatSet, *wordStorage, 0);
+  if(fileStat.st_size == 0) {
+    close(fileDescriptor);
+    return true;
+  }
+
+  size_t fileLength = fileStat.st_size;
+  void *mapping = mmap(NULL, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+  close(fileDescriptor);
+  if(mapping == MAP_FAILED) {
+    printf("ERROR:  Couldn't map file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+  madvise(mapping, fileLength, MADV_SEQUENTIAL);
+  (*wordStorage)->mappedData = (char *)mapping;
+  (*wordStorage)->mappedLength = fileLength;
+
+  if(kThreadCount > 1) {
+    FLLoadJob job;
+    job.text = (char *)mapping;
+    job.textLength = fileLength;
+    job.fileDescriptor = -1;
+    job.workers.resize(kThreadCount);
+    loadTextParallel(&job, *sizeHash, *flatSet, *wordStorage);
+  } else
+    loadMappedLines((char *)mapping, fileLength, *sizeHash, *flatSet, *wordStorage);
+  return true;
+}
+
+// loadMappedLines()
+// Requires:  char *, size_t, FLLengthMap *, FLFlatSet *, FLWordStorage *
+// Returns:   None
+// Sequential loop of mapStringFile() over the text of the storage's mapping:  the
+// whole text is lower cased with the ingest kernel (which only writes, and copies the
+// pages of, the characters that change), then each line is found with the ingest
+// kernel, trimmed with trimLineInPlace(), and a non-empty word is interned with
+// addWordToHashes().  With --stats, the cleaning is timed.
+void loadMappedLines(char *text, size_t textLength, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		     FLWordStorage *wordStorage) {
+  char *lineStart = text;
+  char *fileEnd = text + textLength;
+  if(kDoStats) {
+    std::chrono::steady_clock::time_point cleanStart = std::chrono::steady_clock::now();
+    gLowerInPlace(text, textLength);
+    gLoadStats.cleanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now()
+							     - cleanStart).count();
+  } else
+    gLowerInPlace(text, textLength);
+  while(lineStart < fileEnd) {
+    char *lineEnd = (char *)gFindNewline(lineStart, fileEnd);
+    char *word = lineStart;
+    size_t wordLen;
+    gLoadStats.linesRead++;
+    if(kDoStats) {
+      std::chrono::steady_clock::time_point cleanStart = std::chrono::steady_clock::now();
+      wordLen = trimLineInPlace(word, lineEnd - lineStart);
+      gLoadStats.cleanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now()
+							       - cleanStart).count();
+    } else
+      wordLen = trimLineInPlace(word, lineEnd - lineStart);
+    if(wordLen > 0)
+      addWordToHashes(FLWordView{ word, wordLen }, sizeHash, flatSet, wordStorage);
+    lineStart = lineEnd + 1;
+  }
+}
+
+// runLoadStep()
+// Requires:  FLLoadJob *, function pointer
+// Returns:   None
+// Runs one step of the parallel loader:  step(job, i) on one thread per worker i,
+// and waits for all of them.
+void runLoadStep(FLLoadJob *job, void (*step)(FLLoadJob *, size_t)) {
+  std::vector<std::thread> threads;
+  for(size_t i = 0; i < job->workers.size(); i++)
+    threads.push_back(std::thread(step, job, i));
+  for(size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+// readLoadChunk()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  reads the worker's equal part of the file into the same part of the text
+// with pread(), setting readFailed on an error or an early end of the file.
+void readLoadChunk(FLLoadJob *job, size_t workerIndex) {
+  FLLoadWorker &worker = job->workers[workerIndex];
+  size_t workerCount = job->workers.size();
+  size_t readOffset = job->textLength * workerIndex / workerCount;
+  size_t readEnd = job->textLength * (workerIndex + 1) / workerCount;
+  worker.readFailed = false;
+  while(readOffset < readEnd) {
+    ssize_t readLength = pread(job->fileDescriptor, job->text + readOffset, readEnd - readOffset, readOffset);
+    if(readLength <= 0) {
+      worker.readFailed = true;
+      return;
+    }
+    readOffset += readLength;
+  }
+}
+
+// splitLoadChunks()
+// Requires:  FLLoadJob *
+// Returns:   None
+// Splits the text into one chunk per worker, of about equal size, each ending just
+// after a newline (or at the end of the text), so every line is in exactly one chunk.
+// Chunks may be empty when lines are longer than the chunk size.
+void splitLoadChunks(FLLoadJob *job) {
+  size_t workerCount = job->workers.size();
+  char *textEnd = job->text + job->textLength;
+  char *chunkStart = job->text;
+  for(size_t i = 0; i < workerCount; i++) {
+    char *chunkEnd = job->text + job->textLength * (i + 1) / workerCount;
+    if(chunkEnd < chunkStart)
+      chunkEnd = chunkStart;
+    else if(chunkEnd > job->text && chunkEnd < textEnd && chunkEnd[-1] != '\n') {
+      chunkEnd = (char *)gFindNewline(chunkEnd, textEnd);
+      if(chunkEnd < textEnd) chunkEnd++;
+    }
+    job->workers[i].chunkStart = chunkStart;
+    job->workers[i].chunkEnd = chunkEnd;
+    chunkStart = chunkEnd;
+  }
+}
+
+// cleanLoadChunk()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  lower cases the worker's chunk with the ingest kernel, then finds and
+// trims each line as loadMappedLines() does, and records its word entry, hash, and
+// status (empty, too long, or a word).
+void cleanLoadChunk(FLLoadJob *job, size_t workerIndex) {
+  FLLoadWorker &worker = job->workers[workerIndex];
+  gLowerInPlace(worker.chunkStart, worker.chunkEnd - worker.chunkStart);
+  char *lineStart = worker.chunkStart;
+  while(lineStart < worker.chunkEnd) {
+    char *lineEnd = (char *)gFindNewline(lineStart, worker.chunkEnd);
+    char *word = lineStart;
+    size_t wordLen = trimLineInPlace(word, lineEnd - lineStart);
+    FLLoadLine line = { 0, wordLen };
+    uint8_t status = kLoadLineEmpty;
+    if(wordLen > kMaxWordChars)
+      status = kLoadLineTooLong;
+    else if(wordLen > 0) {
+      line.entry = (FLWordEntry)(word - job->text) << 24 | wordLen;
+      line.hash = hashWordChars(word, wordLen);
+      status = kLoadLineWord;
+    }
+    worker.lines.push_back(line);
+    worker.lineStatus.push_back(status);
+    lineStart = lineEnd + 1;
+  }
+}
+
+// loadRangeStart()
+// Requires:  size_t, size_t, size_t
+// Returns:   size_t
+// Returns the first slot of a slot range:  the slots are split into rangeCount
+// ranges of about equal size, and slot s is in range (s * rangeCount) / slotCount.
+size_t loadRangeStart(size_t range, size_t rangeCount, size_t slotCount) {
+  return (range * slotCount + rangeCount - 1) / rangeCount;
+}
+
+// partitionLoadChunk()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  lists the words of the worker's chunk by the slot range (one per worker)
+// of their home slot in the set, in line order.
+void partitionLoadChunk(FLLoadJob *job, size_t workerIndex) {
+  FLLoadWorker &worker = job->workers[workerIndex];
+  size_t rangeCount = job->workers.size();
+  size_t slotCount = job->flatSet->mask + 1;
+  worker.rangeLines.clear();
+  worker.rangeLines.resize(rangeCount);
+  for(size_t i = 0; i < worker.lines.size(); i++)
+    if(worker.lineStatus[i] == kLoadLineWord)
+      worker.rangeLines[((worker.lines[i].hash & job->flatSet->mask) * rangeCount) / slotCount].push_back(i);
+}
+
+// loadLineWorker()
+// Requires:  FLLoadJob *, size_t
+// Returns:   FLLoadWorker *
+// Returns the worker whose chunk holds the line (numbered across the workers).
+FLLoadWorker *loadLineWorker(FLLoadJob *job, size_t lineNumber) {
+  size_t i = job->workers.size() - 1;
+  while(job->workers[i].firstLine > lineNumber)
+    i--;
+  return &job->workers[i];
+}
+
+// probeLoadSlots()
+// Requires:  FLLoadJob *, const FLLoadLine reference, size_t, size_t
+// Returns:   FLLoadProbe
+// Walks the probe sequence of the line's word in the set being built, whose slots
+// hold line numbers (plus one) until renumberLoadRange().  Returns kLoadProbeDuplicate
+// if an earlier line holds the same word, or claims the first empty slot for the line
+// and returns kLoadProbeInserted.  If the probe reaches slotLimit first (the end of the
+// caller's slot range; SIZE_MAX for no limit), it returns kLoadProbeOverflow.
+FLLoadProbe probeLoadSlots(FLLoadJob *job, const FLLoadLine &line, size_t lineNumber, size_t slotLimit) {
+  FLFlatSlot *slots = job->flatSet->slots.data();
+  uint32_t hashTag = (uint32_t)(line.hash >> 32);
+  size_t wordLen = line.entry & kMaxWordChars;
+  const char *word = job->text + (line.entry >> 24);
+  size_t slot = line.hash & job->flatSet->mask;
+  while(true) {
+    if(slots[slot].wordNumber == 0) {
+      FLFlatSlot newSlot = { hashTag, (uint32_t)(lineNumber + 1) };
+      slots[slot] = newSlot;
+      return kLoadProbeInserted;
+    }
+    if(slots[slot].hashTag == hashTag) {
+      size_t storedNumber = slots[slot].wordNumber - 1;
+      FLLoadWorker *storedWorker = loadLineWorker(job, storedNumber);
+      FLWordEntry stored = storedWorker->lines[storedNumber - storedWorker->firstLine].entry;
+      if((stored & kMaxWordChars) == wordLen && memcmp(job->text + (stored >> 24), word, wordLen) == 0)
+	return kLoadProbeDuplicate;
+    }
+    slot++;
+    if(slot == slotLimit) return kLoadProbeOverflow;
+    slot &= job->flatSet->mask;
+  }
+}
+
+// insertLoadRange()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  inserts the words whose home slot is in the slot range into the set, in
+// line order (all chunks, in order), marking the words already there as duplicates.
+// Only slots of the range are written; words whose probe runs past the end of the
+// range are listed in overflowLines for loadTextParallel() to insert afterwards.
+// The same word always has the same home slot, so the first line of a word is the
+// one kept, as in the sequential loaders.
+void insertLoadRange(FLLoadJob *job, size_t range) {
+  size_t rangeCount = job->workers.size();
+  size_t rangeEnd = loadRangeStart(range + 1, rangeCount, job->flatSet->mask + 1);
+  std::vector<uint32_t> &overflowLines = job->workers[range].overflowLines;
+  for(size_t w = 0; w < rangeCount; w++) {
+    FLLoadWorker &worker = job->workers[w];
+    std::vector<uint32_t> &lineList = worker.rangeLines[range];
+    for(size_t i = 0; i < lineList.size(); i++) {
+      size_t lineNumber = worker.firstLine + lineList[i];
+      FLLoadProbe probe = probeLoadSlots(job, worker.lines[lineList[i]], lineNumber, rangeEnd);
+      if(probe == kLoadProbeDuplicate)
+	worker.lineStatus[lineList[i]] = kLoadLineDuplicate;
+      else if(probe == kLoadProbeOverflow)
+	overflowLines.push_back(lineNumber);
+    }
+  }
+}
+
+// numberLoadChunkWords()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  numbers the loaded words of the worker's chunk from firstWord, writes
+// their entries to the word table, and replaces their hashes with their table indices.
+void numberLoadChunkWords(FLLoadJob *job, size_t workerIndex) {
+  FLLoadWorker &worker = job->workers[workerIndex];
+  size_t wordIndex = worker.firstWord;
+  for(size_t i = 0; i < worker.lines.size(); i++) {
+    if(worker.lineStatus[i] != kLoadLineWord) continue;
+    job->entries[wordIndex] = worker.lines[i].entry;
+    worker.lines[i].hash = wordIndex++;
+  }
+}
+
+// renumberLoadRange()
+// Requires:  FLLoadJob *, size_t
+// Returns:   None
+// Load step:  replaces the line numbers in the slots of the range with the table
+// indices of the words, so the set is equivalent (same members and lookups) to one
+// built by flatSetInsert().  Probes that crossed into the next range may leave words
+// in other slots than sequential inserts would, so the layout can differ.
+void renumberLoadRange(FLLoadJob *job, size_t range) {
+  size_t rangeCount = job->workers.size();
+  size_t slotCount = job->flatSet->mask + 1;
+  FLFlatSlot *slots = job->flatSet->slots.data();
+  for(size_t slot = loadRangeStart(range, rangeCount, slotCount);
+      slot < loadRangeStart(range + 1, rangeCount, slotCount); slot++) {
+    if(slots[slot].wordNumber == 0) continue;
+    size_t lineNumber = slots[slot].wordNumber - 1;
+    FLLoadWorker *worker = loadLineWorker(job, lineNumber);
+    slots[slot].wordNumber = (uint32_t)(worker->lines[lineNumber - worker->firstLine].hash + 1);
+  }
+}
+
+// loadTextParallel()
+// Requires:  FLLoadJob * (text, textLength, and one worker per thread set),
+//            FLLengthMap *, FLFlatSet *, FLWordStorage *
+// Returns:   None
+// Parallel loader for -j N, with the same results as loadMappedLines() on the same
+// text (the mapping of the word storage):  the same words in the same table order,
+// the same length buckets, counters, and messages.
+// (1) Split the text into newline aligned chunks; each thread lower cases, trims, and
+//     hashes the lines of its chunk into its own line list (timed as cleaning).
+// (2) Size the set for the number of words, split its slots into one range per thread,
+//     and list each chunk's words by the range of their home slot.
+// (3) Each thread inserts the words of its slot range in line order, so the first line
+//     of each word is kept and the later ones are marked as duplicates; only the few
+//     probes that cross into the next range are left for one thread to finish.
+// (4) Number the loaded words in line order (chunk by chunk, from the counts of the
+//     chunks), filling the word table, and replace the line numbers in the slots.
+//     The set is equivalent (same members and lookups) to a sequential load's, not
+//     identical slot for slot (see renumberLoadRange()).
+// (5) Add the words to the length buckets (and to the --stream DAWG) and report
+//     duplicates and over long words in line order, on one thread.
+// More than UINT32_MAX lines fall back to loadMappedLines() after step (1).
+void loadTextParallel(FLLoadJob *job, FLLengthMap *sizeHash, FLFlatSet *flatSet, FLWordStorage *wordStorage) {
+  job->flatSet = flatSet;
+  splitLoadChunks(job);
+  std::chrono::steady_clock::time_point cleanStart = std::chrono::steady_clock::now();
+  runLoadStep(job, cleanLoadChunk);
+  if(kDoStats)
+    gLoadStats.cleanSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now()
+							     - cleanStart).count();
+  size_t lineCount = 0;
+  size_t wordLineCount = 0;
+  for(size_t i = 0; i < job->workers.size(); i++) {
+    FLLoadWorker &worker = job->workers[i];
+    worker.firstLine = lineCount;
+    lineCount += worker.lines.size();
+    wordLineCount += std::count(worker.lineStatus.begin(), worker.lineStatus.end(), (uint8_t)kLoadLineWord);
+  }
+  if(lineCount >= UINT32_MAX) {
+    loadMappedLines(job->text, job->textLength, sizeHash, flatSet, wordStorage);
+    return;
+  }
+
+  initFlatSet(flatSet, wordStorage, wordLineCount);
+  runLoadStep(job, partitionLoadChunk);
+  runLoadStep(job, insertLoadRange);
+  for(size_t range = 0; range < job->workers.size(); range++) {
+    std::vector<uint32_t> &overflowLines = job->workers[range].overflowLines;
+    for(size_t i = 0; i < overflowLines.size(); i++) {
+      FLLoadWorker *worker = loadLineWorker(job, overflowLines[i]);
+      size_t lineIndex = overflowLines[i] - worker->firstLine;
+      if(probeLoadSlots(job, worker->lines[lineIndex], overflowLines[i], SIZE_MAX) == kLoadProbeDuplicate)
+	worker->lineStatus[lineIndex] = kLoadLineDuplicate;
+    }
+  }
+
+  size_t wordCount = 0;
+  for(size_t i = 0; i < job->workers.size(); i++) {
+    FLLoadWorker &worker = job->workers[i];
+    worker.firstWord = wordCount;
+    wordCount += std::count(worker.lineStatus.begin(), worker.lineStatus.end(), (uint8_t)kLoadLineWord);
+  }
+  wordStorage->words.resize(wordCount);
+  wordStorage->entries = wordStorage->words.data();
+  wordStorage->wordCount = wordCount;
+  job->entries = wordStorage->words.data();
+  runLoadStep(job, numberLoadChunkWords);
+  runLoadStep(job, renumberLoadRange);
+  flatSet->count = wordCount;
+
+  unsigned long lineNumber = gLoadStats.linesRead;
+  for(size_t i = 0; i < job->workers.size(); i++) {
+    FLLoadWorker &worker = job->workers[i];
+    for(size_t j = 0; j < worker.lines.size(); j++) {
+      FLLoadLine &line = worker.lines[j];
+      lineNumber++;
+      if(worker.lineStatus[j] == kLoadLineWord) {
+	(*sizeHash)[line.entry & kMaxWordChars].push_back((uint32_t)line.hash);
+	streamDawgWord(FLWordView{ job->text + (line.entry >> 24), (size_t)(line.entry & kMaxWordChars) },
+		       lineNumber);
+      } else if(worker.lineStatus[j] == kLoadLineDuplicate) {
+	if(kDoDebug) printf("Dropping duplicate word %.*s\n", (int)(line.entry & kMaxWordChars),
+			    job->text + (line.entry >> 24));
+	gLoadStats.duplicatesDropped++;
+      } else if(worker.lineStatus[j] == kLoadLineTooLong)
+	printf("ERROR:  Skipping a word of %lu characters (the limit is %lu).\n",
+	       (unsigned long)line.hash, (unsigned long)kMaxWordChars);
+    }
+  }
+  gLoadStats.linesRead += lineCount;
+  gLoadStats.wordsLoaded += wordCount;
+}
+
+// deleteWordStorage()
+// Requires:  FLWordStorage * (may be NULL)
+// Returns:   None
+// Unmaps the file mapping, if any, and deletes the storage (arena and word table).
+// Views into the storage are invalid afterwards.
+void deleteWordStorage(FLWordStorage *wordStorage) {
+  if(wordStorage == NULL) return;
+  if(wordStorage->mappedData != NULL)
+    munmap(wordStorage->mappedData, wordStorage->mappedLength);
+  delete wordStorage;
+}
+
+// ownWordStorage()
+// Requires:  FLWordStorage *, FLFlatSet * (may be NULL)
+// Returns:   None
+// Makes a loaded dictionary modifiable:  the words of a mapped storage (--mmap, -j,
+// or a snapshot) are copied into the arena in table order, with the word table and
+// the slots of the flat set (from a snapshot) copied too, and the mapping is unmapped.
+// Word table indices stay the same; views into the storage are invalid afterwards.
+void ownWordStorage(FLWordStorage *wordStorage, FLFlatSet *flatSet) {
+  if(flatSet != NULL && flatSet->slotTable != flatSet->slots.data()) {
+    flatSet->slots.assign(flatSet->slotTable, flatSet->slotTable + flatSet->mask + 1);
+    flatSet->slotTable = flatSet->slots.data();
+  }
+  if(wordStorage->entries != wordStorage->words.data())
+    wordStorage->words.assign(wordStorage->entries, wordStorage->entries + wordStorage->wordCount);
+  wordStorage->entries = wordStorage->words.data();
+  if(wordStorage->mappedData == NULL) return;
+
+  std::vector<char> arena;
+  for(size_t i = 0; i < wordStorage->wordCount; i++) {
+    FLWordView word = storedWord(wordStorage, i);
+    wordStorage->words[i] = (FLWordEntry)arena.size() << 24 | word.length;
+    arena.insert(arena.end(), word.data, word.data + word.length);
+  }
+  munmap(wordStorage->mappedData, wordStorage->mappedLength);
+  wordStorage->mappedData = NULL;
+  wordStorage->mappedLength = 0;
+  wordStorage->arena.swap(arena);
+}
+
+// appendStoredWord()
+// Requires:  FLWordStorage * (not mapped), const FLWordView reference (not in the storage)
+// Returns:   uint32_t
+// Copies the word to the end of the arena and adds its entry to the word table;
+// returns its table index.  The arena may move, invalidating views into the storage.
+uint32_t appendStoredWord(FLWordStorage *wordStorage, const FLWordView &word) {
+  size_t offset = wordStorage->arena.size();
+  wordStorage->arena.insert(wordStorage->arena.end(), word.data, word.data + word.length);
+  wordStorage->words.push_back((FLWordEntry)offset << 24 | word.length);
+  wordStorage->entries = wordStorage->words.data();
+  wordStorage->wordCount = wordStorage->words.size();
+  return wordStorage->wordCount - 1;
+}
+
+// writeSnapshotFile()
+// Requires:  std::string reference, FLLengthMap *, FLFlatSet *, FLWordStorage *,
+//            const FLDoubleArray * (may be NULL)
+// Returns:   bool
+// Writes the loaded dictionary as a snapshot (see FLSnapshotHeader) to the named file:
+// the characters of the words in table order (so the table indices, slots, and buckets
+// stay valid), the word table with the new offsets, the flat set slots as they are, the
+// length buckets in increasing length, and the double array, if given, as it is.
+// Returns false (with an error) if the file cannot be written.
+bool writeSnapshotFile(std::string &fileName, FLLengthMap *sizeHash, FLFlatSet *flatSet,
+		       FLWordStorage *wordStorage, const FLDoubleArray *doubleArray) {
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if(file == NULL) {
+    printf("ERROR:  Couldn't open file %s for output.\n", fileName.c_str());
+    return false;
+  }
+  size_t wordCount = wordStorage->wordCount;
+  std::vector<size_t> lengths;
+  for(auto sizeHashIter = sizeHash->begin(); sizeHashIter != sizeHash->end(); ++sizeHashIter)
+    lengths.push_back(sizeHashIter->first);
+  std::sort(lengths.begin(), lengths.end());
+
+  FLSnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.byteOrder = kSnapshotByteOrder;
+  header.hashCheck = hashWordChars(kSnapshotHashCheckWord, strlen(kSnapshotHashCheckWord));
+  header.wordCount = wordCount;
+  header.maxWordLength = lengths.empty() ? 0 : lengths.back();
+  header.charsOffset = sizeof(header);
+  for(size_t i = 0; i < wordCount; i++)
+    header.charsLength += storedWord(wordStorage, i).length;
+  header.entriesOffset = (header.charsOffset + header.charsLength + 7) & ~(uint64_t)7;
+  header.slotsOffset = header.entriesOffset + wordCount * sizeof(FLWordEntry);
+  header.slotCount = flatSet->mask + 1;
+  header.bucketsOffset = header.slotsOffset + header.slotCount * sizeof(FLFlatSlot);
+  header.bucketCount = lengths.size();
+  header.indicesOffset = header.bucketsOffset + header.bucketCount * sizeof(FLSnapshotBucket);
+  header.fileLength = header.indicesOffset + wordCount * sizeof(uint32_t);
+  if(doubleArray != NULL) {
+    header.doubleArrayOffset = (header.fileLength + 7) & ~(uint64_t)7;
+    header.doubleArrayUnitCount = doubleArray->unitCount;
+    header.fileLength = header.doubleArrayOffset + sizeof(doubleArray->codes) +
+      doubleArray->unitCount * sizeof(FLDoubleArrayUnit);
+  }
+
+  std::vector<FLWordEntry> entries(wordCount);
+  fwrite(&header, sizeof(header), 1, file);
+  uint64_t offset = header.charsOffset;
+  for(size_t i = 0; i < wordCount; i++) {
+    FLWordView word = storedWord(wordStorage, i);
+    fwrite(word.data, 1, word.length, file);
+    entries[i] = offset << 24 | word.length;
+    offset += word.length;
+  }
+  static const char padding[8] = { 0 };
+  fwrite(padding, 1, header.entriesOffset - offset, file);
+  fwrite(entries.data(), sizeof(FLWordEntry), wordCount, file);
+  fwrite(flatSet->slotTable, sizeof(FLFlatSlot), header.slotCount, file);
+  uint64_t firstIndex = 0;
+  for(size_t i = 0; i < lengths.size(); i++) {
+    FLSnapshotBucket bucket = { lengths[i], firstIndex, (*sizeHash)[lengths[i]].size() };
+    fwrite(&bucket, sizeof(bucket), 1, file);
+    firstIndex += bucket.count;
+  }
+  for(size_t i = 0; i < lengths.size(); i++) {
+    std::vector<uint32_t> &wordList = (*sizeHash)[lengths[i]];
+    fwrite(wordList.data(), sizeof(uint32_t), wordList.size(), file);
+  }
+  if(doubleArray != NULL) {
+    uint64_t indicesEnd = header.indicesOffset + wordCount * sizeof(uint32_t);
+    fwrite(padding, 1, header.doubleArrayOffset - indicesEnd, file);
+    fwrite(doubleArray->codes, 1, sizeof(doubleArray->codes), file);
+    fwrite(doubleArray->unitTable, sizeof(FLDoubleArrayUnit), doubleArray->unitCount, file);
+  }
+  if(ferror(file) | fclose(file)) {
+    printf("ERROR:  Couldn't write file %s.\n", fileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+// isSnapshotFile()
+// Requires:  std::string reference
+// Returns:   bool
+// Returns true if the file starts with the snapshot magic (a text word list cannot,
+// since the magic holds control characters that cleaning would not keep).
+bool isSnapshotFile(std::string &fileName) {
+  char magic[sizeof(kSnapshotMagic)];
+  FILE *file = fopen(fileName.c_str(), "rb");
+  if(file == NULL) return false;
+  bool isSnapshot = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+    memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+  fclose(file);
+  return isSnapshot;
+}
+
+// mapSnapshotFile()
+// Requires:  std::string reference, FLLengthMap **, FLFlatSet **, FLWordStorage **,
+//            FLDoubleArray **
+// Returns:   bool
+// Loads a snapshot written by writeSnapshotFile() without rebuilding anything:  the
+// file is mapped read only, and the word storage and flat set use its characters,
+// word table, and slots in place, as does the double array (set only if the snapshot
+// has one and the engine is dat; NULL otherwise).  Only the length buckets are copied into the
+// length map (4 bytes per word), so -s can sort them.  Failure to open or map the
+// file, or a header that does not match this program or the file, causes an
+// immediate exit.  The sections are bounds checked, and the bucket indices are
+// checked while copying; the word table is trusted.
+bool mapSnapshotFile(std::string &fileName, FLLengthMap **sizeHash, FLFlatSet **flatSet,
+		     FLWordStorage **wordStorage, FLDoubleArray **doubleArray) {
+  int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if(fileDescriptor < 0 || fstat(fileDescriptor, &fileStat) != 0) {
+    printf("ERROR:  Couldn't open file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+  size_t fileLength = fileStat.st_size;
+  if(fileLength < sizeof(FLSnapshotHeader)) {
+    printf("ERROR:  %s is too short for a snapshot.\n", fileName.c_str());
+    exit(1);
+  }
+  void *mapping = mmap(NULL, fileLength, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+  close(fileDescriptor);
+  if(mapping == MAP_FAILED) {
+    printf("ERROR:  Couldn't map file %s for input.\n", fileName.c_str());
+    exit(1);
+  }
+
+  const char *data = (const char *)mapping;
+  const FLSnapshotHeader *header = (const FLSnapshotHeader *)data;
+  uint64_t wordCount = header->wordCount;
+  uint64_t slotCount = header->slotCount;
+  bool valid = memcmp(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic)) == 0 &&
+    header->version == kSnapshotVersion && header->byteOrder == kSnapshotByteOrder &&
+    header->hashCheck == hashWordChars(kSnapshotHashCheckWord, strlen(kSnapshotHashCheckWord)) &&
+    header->fileLength == fileLength && wordCount < UINT32_MAX &&
+    slotCount >= 16 && (slotCount & (slotCount - 1)) == 0 && 2 * wordCount <= slotCount &&
+    header->entriesOffset % 8 == 0 && header->charsOffset + header->charsLength <= header->entriesOffset &&
+    header->slotsOffset == header->entriesOffset + wordCount * sizeof(FLWordEntry) &&
+    header->bucketsOffset == header->slotsOffset + slotCount * sizeof(FLFlatSlot) &&
+    header->indicesOffset == header->bucketsOffset + header->bucketCount * sizeof(FLSnapshotBucket) &&
+    (header->doubleArrayUnitCount == 0 ?
+     header->fileLength == header->indicesOffset + wordCount * sizeof(uint32_t) :
+     (header->doubleArrayOffset % 8 == 0 &&
+      header->doubleArrayOffset >= header->indicesOffset + wordCount * sizeof(uint32_t) &&
+      header->fileLength == header->doubleArrayOffset + 256 +
+      header->doubleArrayUnitCount * sizeof(FLDoubleArrayUnit)));
+  if(!valid) {
+    printf("ERROR:  %s is not a snapshot for this version of the program; compile it again.\n",
+	   fileName.c_str());
+    exit(1);
+  }
+
+  *wordStorage = newWordStorage();
+  (*wordStorage)->mappedData = (char *)mapping;
+  (*wordStorage)->mappedLength = fileLength;
+  (*wordStorage)->entries = (const FLWordEntry *)(data + header->entriesOffset);
+  (*wordStorage)->wordCount = wordCount;
+  *flatSet = new FLFlatSet;
+  (*flatSet)->wordStorage = *wordStorage;
+  (*flatSet)->slotTable = (const FLFlatSlot *)(data + header->slotsOffset);
+  (*flatSet)->mask = slotCount - 1;
+  (*flatSet)->count = wordCount;
+
+  *sizeHash = new FLLengthMap;
+  const FLSnapshotBucket *buckets = (const FLSnapshotBucket *)(data + header->bucketsOffset);
+  const uint32_t *indices = (const uint32_t *)(data + header->indicesOffset);
+  for(uint64_t i = 0; i < header->bucketCount; i++) {
+    const FLSnapshotBucket &bucket = buckets[i];
+    if(bucket.firstIndex > wordCount || bucket.count > wordCount - bucket.firstIndex) {
+      printf("ERROR:  Snapshot %s has a bad length bucket.\n", fileName.c_str());
+      exit(1);
+    }
+    std::vector<uint32_t> &wordList = (**sizeHash)[bucket.length];
+    wordList.assign(indices + bucket.firstIndex, indices + bucket.firstIndex + bucket.count);
+    for(size_t j = 0; j < wordList.size(); j++) {
+      if(wordList[j] >= wordCount) {
+	printf("ERROR:  Snapshot %s has a bad word index.\n", fileName.c_str());
+	exit(1);
+      }
+    }
+  }
+  *doubleArray = NULL;
+  if(header->doubleArrayUnitCount > 0 && kEngine == kEngineDoubleArray) {
+    *doubleArray = new FLDoubleArray;
+    memcpy((*doubleArray)->codes, data + header->doubleArrayOffset, sizeof((*doubleArray)->codes));
+    (*doubleArray)->unitTable = (const FLDoubleArrayUnit *)(data + header->doubleArrayOffset + 256);
+    (*doubleArray)->unitCount = header->doubleArrayUnitCount;
+  }
+  gLoadStats.wordsLoaded = wordCount;
+  return true;
+}
+
+// printStats()
+// Requires:  FLSearchContext *, FLSuffixCache *, int
+// Returns:   None
+// Prints the phase times, loader counters, and search counters for --stats, one
+// "stats.<name>=<value>" line each, so they can be scraped with grep or split on '='.
+// Times are in seconds; the histogram lines are named by their lookup ranges and
+// only printed up to the last non-empty bucket.
+void printStats(FLSearchContext *context, FLSuffixCache *suffixCache, int countFound) {
+  for(int phase = 0; phase < kPhaseCount; phase++) {
+    printf("stats.phase.%s.wall_s=%.6f\n", kPhaseNames[phase], gPhaseWallSeconds[phase]);
+    printf("stats.phase.%s.cpu_s=%.6f\n", kPhaseNames[phase], gPhaseCpuSeconds[phase]);
+    if(phase == kPhaseLoad)
+      printf("stats.phase.clean.wall_s=%.6f\n", gLoadStats.cleanSeconds);
+  }
+  printf("stats.lines_read=%lu\n", gLoadStats.linesRead);
+  printf("stats.words_loaded=%lu\n", gLoadStats.wordsLoaded);
+  printf("stats.duplicates_dropped=%lu\n", gLoadStats.duplicatesDropped);
+  printf("stats.threads=%d\n", kThreadCount);
+  printf("stats.ingest_kernel=%s\n", kIngestNames[kIngest]);
+  if(kDoStream) {
+    printf("stats.stream.sorted_input=%d\n", gLoadStats.sortedInput ? 1 : 0);
+    printf("stats.stream.first_unsorted_line=%lu\n", gLoadStats.firstUnsortedLine);
+  }
+
+  FLSearchStats &stats = context->stats;
+  printf("stats.words_tested=%lu\n", stats.wordsTested);
+  printf("stats.words_found=%d\n", countFound);
+  printf("stats.probes=%lu\n", stats.lookups);
+  printf("stats.probes_max_per_word=%lu\n", stats.maxLookupsPerWord);
+  printf("stats.recursion_calls=%lu\n", stats.checkCalls);
+  printf("stats.recursion_max_depth=%lu\n", stats.maxCheckDepth);
+  printf("stats.trie_node_steps=%lu\n", stats.trieNodeSteps);
+  printf("stats.hashed_chars=%lu\n", stats.hashedChars);
+  printf("stats.cache_hits=%lu\n", suffixCache->hits);
+  printf("stats.cache_misses=%lu\n", suffixCache->misses);
+  printf("stats.cache_dropped=%lu\n", suffixCache->dropped);
+  printf("stats.alerts=%lu\n", stats.alerts);
+  printf("stats.search_allocations=%lu\n", stats.allocations);
+  printf("stats.length_skips=%lu\n", stats.lengthSkips);
+  if(context->bloomFilter != NULL) {
+    const FLBloomFilter *bloomFilter = context->bloomFilter;
+    unsigned long storeMisses = stats.bloomNegatives + stats.bloomFalsePositives;
+    printf("stats.bloom.bits_per_word=%lu\n", (unsigned long)kBloomBitsPerKey);
+    printf("stats.bloom.probes_per_word=%u\n", bloomFilter->probeCount);
+    printf("stats.bloom.bytes=%lu\n",
+	   (unsigned long)(bloomFilter->blockCount * kBloomBlockWords * sizeof(uint64_t)));
+    printf("stats.bloom.negatives=%lu\n", stats.bloomNegatives);
+    printf("stats.bloom.false_positives=%lu\n", stats.bloomFalsePositives);
+    printf("stats.bloom.true_negative_rate=%.4f\n",
+	   storeMisses ? (double)stats.bloomNegatives / storeMisses : 0.0);
+  }
+  if(context->doubleArray != NULL) {
+    size_t doubleArrayBytes = context->doubleArray->unitCount * sizeof(FLDoubleArrayUnit);
+    printf("stats.double_array.units=%lu\n", (unsigned long)context->doubleArray->unitCount);
+    printf("stats.double_array.bytes=%lu\n", (unsigned long)doubleArrayBytes);
+    printf("stats.double_array.bytes_per_word=%.2f\n",
+	   context->wordStorage->wordCount ? (double)doubleArrayBytes / context->wordStorage->wordCount : 0.0);
+  }
+  if(context->dawg != NULL) {
+    const FLDawg *dawg = context->dawg;
+    size_t dawgBytes = dawg->states.size() * sizeof(FLDawgState) + dawg->arcLetters.size() +
+      dawg->arcTargets.size() * sizeof(uint32_t);
+    printf("stats.dawg.states=%lu\n", (unsigned long)dawg->states.size());
+    printf("stats.dawg.arcs=%lu\n", (unsigned long)dawg->arcLetters.size());
+    printf("stats.dawg.bytes=%lu\n", (unsigned long)dawgBytes);
+    printf("stats.dawg.bytes_per_word=%.2f\n",
+	   context->wordStorage->wordCount ? (double)dawgBytes / context->wordStorage->wordCount : 0.0);
+  }
+
+  size_t lastBucket = 0;
+  for(size_t i = 0; i < kLookupHistogramBuckets; i++)
+    if(stats.lookupHistogram[i] > 0) lastBucket = i;
+  for(size_t i = 0; i <= lastBucket; i++) {
+    unsigned long low = i ? 1ul << (i - 1) : 0, high = i ? (1ul << i) - 1 : 0;
+    if(i + 1 == kLookupHistogramBuckets)
+      printf("stats.probes_per_word.%lu+=%lu\n", low, stats.lookupHistogram[i]);
+    else
+      printf("stats.probes_per_word.%lu-%lu=%lu\n", low, high, stats.lookupHistogram[i]);
+  }
+}
+
+// stopServing()
+// Requires:  int
+// Returns:   None
+// SIGINT and SIGTERM handler of the query server:  the poll loop stops at its next wakeup.
+void stopServing(int) {
+  gServeStop = 1;
+}
+
+// openServeSocket()
+// Requires:  FLServer *, std::string reference
+// Returns:   None
+// Creates the server's listening Unix domain stream socket at the path.  A socket file
+// left at the path by an earlier server is replaced; any other file is not.  Failure
+// causes an immediate exit.
+void openServeSocket(FLServer *server, const std::string &socketPath) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(socketPath.length() >= sizeof(address.sun_path)) {
+    printf("ERROR:  Socket path %s is too long.\n", socketPath.c_str());
+    exit(1);
+  }
+  memcpy(address.sun_path, socketPath.c_str(), socketPath.length());
+  struct stat fileStat;
+  if(lstat(socketPath.c_str(), &fileStat) == 0 && S_ISSOCK(fileStat.st_mode))
+    unlink(socketPath.c_str());
+  server->listenDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(server->listenDescriptor < 0 ||
+     bind(server->listenDescriptor, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+     listen(server->listenDescriptor, SOMAXCONN) != 0) {
+    printf("ERROR:  Couldn't listen on socket %s (%s).\n", socketPath.c_str(), strerror(errno));
+    exit(1);
+  }
+  fcntl(server->listenDescriptor, F_SETFL, O_NONBLOCK);
+  server->socketPath = socketPath;
+}
+
+// serveCheckWord()
+// Requires:  FLServer *, char *, size_t
+// Returns:   bool
+// Cleans the query word in place (as the loaders clean lines) and returns true if it is
+// made of other words of the dictionary, with the engine selected by kEngine.
+bool serveCheckWord(FLServer *server, char *word, size_t wordLen) {
+  wordLen = cleanWordInPlace(word, wordLen);
+  if(wordLen == 0) return false;
+  fitSearchContext(&server->queryContext, wordLen);
+  clearSuffixCache(&server->queryCache);
+  return checkWord(FLWordView{ word, wordLen }, &server->queryContext);
+}
+
+// serveHasWord()
+// Requires:  FLServer *, char *, size_t
+// Returns:   bool
+// Cleans the query word in place and returns true if it is a dictionary word.
+bool serveHasWord(FLServer *server, char *word, size_t wordLen) {
+  wordLen = cleanWordInPlace(word, wordLen);
+  if(wordLen == 0) return false;
+  if(server->queryContext.doubleArray != NULL) {
+    std::vector<size_t> &ends = server->queryContext.trieBoundaries;
+    ends.clear();
+    doubleArrayPrefixSearch(word, wordLen, 0, &server->queryContext, ends);
+    return !ends.empty() && ends.back() == wordLen;
+  }
+  if(server->queryContext.trie != NULL) {
+    int node = 0;
+    for(size_t i = 0; i < wordLen && node >= 0; i++)
+      node = trieFindChild(server->queryContext.trie, node, word[i]);
+    return node >= 0 && (*server->queryContext.trie)[node].endOfWord;
+  }
+  return dictionaryContains(&server->queryContext, word, wordLen);
+}
+
+// trackServeCompounds()
+// Requires:  FLServer *
+// Returns:   None
+// Starts tracking the compounds, if not yet tracked:  checks every word of the
+// dictionary once (as the search does, with the run's suffix cache), and records
+// the state of each word and the set of compounds in search order.
+void trackServeCompounds(FLServer *server) {
+  if(!server->wordStates.empty() || server->wordStorage->wordCount == 0) return;
+  size_t wordCount = server->wordStorage->wordCount;
+  server->wordStates.assign(wordCount, kServeWordPlain);
+  for(size_t i = 0; i < wordCount; i++) {
+    if(!checkWord(storedWord(server->wordStorage, i), server->context)) continue;
+    server->wordStates[i] = kServeWordCompound;
+    server->compounds.insert(server->compounds.end(), i);
+  }
+}
+
+// recheckServeWord()
+// Requires:  FLServer *, uint32_t
+// Returns:   bool
+// Checks the word at the table index again (after an update), with the query context.
+bool recheckServeWord(FLServer *server, uint32_t wordIndex) {
+  FLWordView word = storedWord(server->wordStorage, wordIndex);
+  server->rechecks++;
+  fitSearchContext(&server->queryContext, word.length);
+  clearSuffixCache(&server->queryCache);
+  return checkWord(word, &server->queryContext);
+}
+
+// prepareServeUpdate()
+// Requires:  FLServer *
+// Returns:   None
+// Before the first update:  tracks the compounds, then copies a mapped dictionary
+// into the word storage (ownWordStorage()) and rebuilds the string set of --store=stl,
+// whose views pointed into the mapping.
+void prepareServeUpdate(FLServer *server) {
+  trackServeCompounds(server);
+  if(server->storageOwned) return;
+  FLStringSet *stringSet = server->context->stringSet;
+  bool wasMapped = server->wordStorage->mappedData != NULL;
+  ownWordStorage(server->wordStorage, server->context->flatSet);
+  if(stringSet != NULL && wasMapped) {
+    stringSet->clear();
+    for(size_t i = 0; i < server->wordStorage->wordCount; i++)
+      stringSet->insert(storedWord(server->wordStorage, i));
+  }
+  server->storageOwned = true;
+}
+
+// addServeWord()
+// Requires:  FLServer *, char *, size_t
+// Returns:   bool
+// Cleans the word and adds it to the dictionary (false if it is empty, too long, or
+// already there), updating the compounds.  A new word can only make compounds of
+// longer words containing it, so besides the new word, only the longer words that
+// contain it and are not compounds yet are checked again.
+bool addServeWord(FLServer *server, char *word, size_t wordLen) {
+  wordLen = cleanWordInPlace(word, wordLen);
+  if(wordLen == 0 || wordLen > kMaxWordChars || serveHasWord(server, word, wordLen) ||
+     server->wordStorage->wordCount >= UINT32_MAX)
+    return false;
+  prepareServeUpdate(server);
+  FLWordStorage *wordStorage = server->wordStorage;
+  FLSearchContext *context = server->context;
+  const char *oldArena = wordStorage->arena.data();
+  uint32_t wordIndex = appendStoredWord(wordStorage, FLWordView{ word, wordLen });
+  FLWordView stored = storedWord(wordStorage, wordIndex);
+  if(context->flatSet != NULL)
+    flatSetInsert(context->flatSet, hashWordChars(stored.data, stored.length), wordIndex);
+  if(context->bloomFilter != NULL)
+    bloomInsert(context->bloomFilter, hashWordChars(stored.data, stored.length));
+  addLengthMaskWord(context->lengthMasks, stored);
+  if(context->trie != NULL)
+    trieInsert(context->trie, stored);
+  if(context->stringSet != NULL) {
+    // The views of the set point into the arena, so a moved arena means a new set.
+    if(wordStorage->arena.data() != oldArena) {
+      context->stringSet->clear();
+      for(size_t i = 0; i < wordIndex; i++)
+	if(server->wordStates[i] != kServeWordDeleted)
+	  context->stringSet->insert(storedWord(wordStorage, i));
+    }
+    context->stringSet->insert(stored);
+  }
+  (*server->sizeHash)[wordLen].push_back(wordIndex);
+  server->wordStates.push_back(kServeWordPlain);
+  if(wordLen > context->maxWordLength) {
+    context->maxWordLength = server->queryContext.maxWordLength = wordLen;
+    fitSearchContext(context, wordLen);
+  }
+
+  if(recheckServeWord(server, wordIndex)) {
+    server->wordStates[wordIndex] = kServeWordCompound;
+    server->compounds.insert(wordIndex);
+  }
+  for(auto sizeHashIter = server->sizeHash->begin(); sizeHashIter != server->sizeHash->end(); ++sizeHashIter) {
+    if(sizeHashIter->first <= wordLen) continue;
+    std::vector<uint32_t> &wordList = sizeHashIter->second;
+    for(size_t i = 0; i < wordList.size(); i++) {
+      uint32_t candidate = wordList[i];
+      if(server->wordStates[candidate] != kServeWordPlain) continue;
+      FLWordView longer = storedWord(wordStorage, candidate);
+      if(memmem(longer.data, longer.length, stored.data, stored.length) == NULL) continue;
+      if(recheckServeWord(server, candidate)) {
+	server->wordStates[candidate] = kServeWordCompound;
+	server->compounds.insert(candidate);
+      }
+    }
+  }
+  return true;
+}
+
+// deleteServeWord()
+// Requires:  FLServer *, char *, size_t
+// Returns:   bool
+// Cleans the word and removes it from the dictionary (false if it is not there),
+// updating the compounds.  Removing a word can only break compounds of longer words
+// containing it, so only the longer compounds that contain it are checked again.
+bool deleteServeWord(FLServer *server, char *word, size_t wordLen) {
+  wordLen = cleanWordInPlace(word, wordLen);
+  if(wordLen == 0 || !serveHasWord(server, word, wordLen)) return false;
+  prepareServeUpdate(server);
+  FLWordStorage *wordStorage = server->wordStorage;
+  FLSearchContext *context = server->context;
+  std::vector<uint32_t> &wordList = (*server->sizeHash)[wordLen];
+  size_t listIndex = 0;
+  while(memcmp(storedWord(wordStorage, wordList[listIndex]).data, word, wordLen) != 0)
+    listIndex++;
+  uint32_t wordIndex = wordList[listIndex];
+  FLWordView stored = storedWord(wordStorage, wordIndex);
+  if(context->flatSet != NULL)
+    flatSetErase(context->flatSet, hashWordChars(stored.data, stored.length), stored.data, stored.length);
+  if(context->trie != NULL)
+    trieErase(context->trie, stored);
+  if(context->stringSet != NULL)
+    context->stringSet->erase(stored);
+  wordList.erase(wordList.begin() + listIndex);
+  if(wordList.empty())
+    server->sizeHash->erase(wordLen);
+  if(server->wordStates[wordIndex] == kServeWordCompound)
+    server->compounds.erase(wordIndex);
+  server->wordStates[wordIndex] = kServeWordDeleted;
+  server->deletedWords++;
+
+  // The compounds are ordered longest first, so the longer ones are at the front.
+  for(auto compoundIter = server->compounds.begin(); compoundIter != server->compounds.end(); ) {
+    FLWordView longer = storedWord(wordStorage, *compoundIter);
+    if(longer.length <= wordLen) break;
+    if(memmem(longer.data, longer.length, stored.data, stored.length) != NULL &&
+       !recheckServeWord(server, *compoundIter)) {
+      server->wordStates[*compoundIter] = kServeWordPlain;
+      compoundIter = server->compounds.erase(compoundIter);
+    } else
+      ++compoundIter;
+  }
+  return true;
+}
+
+// handleServeLine()
+// Requires:  FLServer *, FLServeClient *, char *, size_t
+// Returns:   None
+// Handles one request line (without its newline) and appends the response to the
+// client's output.  Requests (see printUsage()) are a command, a space, and an argument:
+//   CHECK <word>  "1" if the word is made of other dictionary words, else "0"
+//   HAS <word>    "1" if the word is in the dictionary, else "0"
+//   BATCH <n>     the next n lines are words to CHECK; one line of n "0"/"1" results
+//   ADD <word>    adds the word to the dictionary:  "1", or "0" if it was there
+//   DEL <word>    removes the word from the dictionary:  "1", or "0" if it was not there
+//                 (refused with the ac, dat, and dawg engines, whose structures are static)
+//   TOP <k>       a line with the number of words n (<= k), then the n longest compounds
+//   COUNT         the number of compounds in the dictionary
+//   STATS         "words=<dictionary words> requests=<requests handled>", then (once the
+//                 compounds are tracked) " compounds=<count> rechecks=<words rechecked>"
+//   PING          "PONG"
+//   QUIT          closes the connection once the earlier responses are sent
+// Anything else gets "ERR <reason>".  Words are cleaned like the lines of the input file.
+void handleServeLine(FLServer *server, FLServeClient *client, char *line, size_t lineLen) {
+  server->requests++;
+  if(client->batchRemaining > 0) {
+    client->batchResults += serveCheckWord(server, line, lineLen) ? '1' : '0';
+    if(--client->batchRemaining == 0) {
+      client->output += client->batchResults;
+      client->output += '\n';
+      client->batchResults.clear();
+    }
+    return;
+  }
+
+  while(lineLen > 0 && line[lineLen - 1] == '\r')
+    lineLen--;
+  char *space = (char *)memchr(line, ' ', lineLen);
+  std::string command(line, space ? space - line : lineLen);
+  char *argument = space ? space + 1 : line + lineLen;
+  size_t argumentLen = line + lineLen - argument;
+  std::string number(argument, argumentLen);
+  char *numberEnd;
+  unsigned long count = strtoul(number.c_str(), &numberEnd, 10);
+  bool countValid = !number.empty() && *numberEnd == '\0';
+
+  if(command == "CHECK")
+    client->output += serveCheckWord(server, argument, argumentLen) ? "1\n" : "0\n";
+  else if(command == "HAS")
+    client->output += serveHasWord(server, argument, argumentLen) ? "1\n" : "0\n";
+  else if((command == "ADD" || command == "DEL") && (server->context->automaton != NULL ||
+						     server->context->doubleArray != NULL ||
+						     server->context->dawg != NULL))
+    client->output += "ERR the ac, dat, and dawg engines do not support updates\n";
+  else if(command == "ADD")
+    client->output += addServeWord(server, argument, argumentLen) ? "1\n" : "0\n";
+  else if(command == "DEL")
+    client->output += deleteServeWord(server, argument, argumentLen) ? "1\n" : "0\n";
+  else if(command == "BATCH") {
+    if(!countValid || count > kServeMaxBatch)
+      client->output += "ERR BATCH requires a count of at most 1048576 words\n";
+    else if(count == 0)
+      client->output += '\n';
+    else {
+      client->batchRemaining = count;
+      client->batchResults.reserve(count);
+    }
+  } else if(command == "TOP") {
+    if(!countValid || count == 0 || count > kServeMaxTop)
+      client->output += "ERR TOP requires a count from 1 to 1048576\n";
+    else {
+      trackServeCompounds(server);
+      size_t topCount = std::min((size_t)count, server->compounds.size());
+      client->output += std::to_string(topCount) + '\n';
+      auto compoundIter = server->compounds.begin();
+      for(size_t i = 0; i < topCount; i++, ++compoundIter) {
+	FLWordView word = storedWord(server->wordStorage, *compoundIter);
+	client->output.append(word.data, word.length);
+	client->output += '\n';
+      }
+    }
+  } else if(command == "COUNT") {
+    trackServeCompounds(server);
+    client->output += std::to_string(server->compounds.size()) + '\n';
+  } else if(command == "STATS") {
+    client->output += "words=" + std::to_string(server->wordStorage->wordCount - server->deletedWords) +
+      " requests=" + std::to_string(server->requests);
+    if(!server->wordStates.empty())
+      client->output += " compounds=" + std::to_string(server->compounds.size()) +
+	" rechecks=" + std::to_string(server->rechecks);
+    client->output += '\n';
+  }
+  else if(command == "PING")
+    client->output += "PONG\n";
+  else if(command == "QUIT")
+    client->closing = true;
+  else
+    client->output += "ERR unknown command\n";
+}
+
+// readServeClient()
+// Requires:  FLServer *, FLServeClient *
+// Returns:   bool
+// Reads what the client has sent and handles every complete request line, in order,
+// so pipelined requests are answered in the order they were sent.  Returns false when
+// the connection should be closed:  the client closed it, or a line is too long.
+bool readServeClient(FLServer *server, FLServeClient *client) {
+  char buffer[kServeReadBytes];
+  ssize_t readLength = read(client->fileDescriptor, buffer, sizeof(buffer));
+  if(readLength < 0)
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  if(readLength == 0) return false;
+  size_t scanStart = client->input.size();
+  client->input.append(buffer, readLength);
+
+  size_t lineStart = 0;
+  while(!client->closing) {
+    char *data = &client->input[0];
+    const char *lineEnd = gFindNewline(data + scanStart, data + client->input.size());
+    if(lineEnd == data + client->input.size()) break;
+    handleServeLine(server, client, data + lineStart, lineEnd - (data + lineStart));
+    lineStart = scanStart = lineEnd - data + 1;
+  }
+  client->input.erase(0, lineStart);
+  if(client->input.size() > kServeMaxLine) {
+    client->output += "ERR request line too long\n";
+    client->closing = true;
+  }
+  return true;
+}
+
+// writeServeClient()
+// Requires:  FLServeClient *
+// Returns:   bool
+// Sends as much of the client's pending output as the socket takes.  Returns false
+// when the connection should be closed:  a send error, or QUIT with all output sent.
+bool writeServeClient(FLServeClient *client) {
+  if(!client->output.empty()) {
+    ssize_t sent = send(client->fileDescriptor, client->output.data(), client->output.size(), MSG_NOSIGNAL);
+    if(sent < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    client->output.erase(0, sent);
+  }
+  return !(client->closing && client->output.empty());
+}
+
+// serveDictionary()
+// Requires:  std::string reference, FLSearchContext *, FLLengthMap *, FLWordStorage *
+// Returns:   None
+// Query server mode (--serve):  answers requests (see handleServeLine()) on a Unix
+// domain socket at the path, using (and updating) the loaded dictionary, until SIGINT
+// or SIGTERM.
+// One thread serves every client with poll(); each client's requests are handled in
+// order as whole lines arrive, so a client may pipeline requests without waiting for
+// responses.  A client whose unsent responses exceed kServeMaxOutput is not read from
+// until it catches up.  The socket file is removed on exit.
+void serveDictionary(const std::string &socketPath, FLSearchContext *context, FLLengthMap *sizeHash,
+		     FLWordStorage *wordStorage) {
+  FLServer server;
+  server.context = context;
+  server.sizeHash = sizeHash;
+  server.wordStorage = wordStorage;
+  server.compounds = FLCompoundSet(FLCompoundOrder{ wordStorage });
+  server.storageOwned = false;
+  server.deletedWords = 0;
+  server.requests = 0;
+  server.rechecks = 0;
+  initSuffixCache(&server.queryCache, kSuffixCacheMB ? (1 << 16) : 0, 256);
+  initSearchContext(&server.queryContext, context->wordStorage, context->stringSet, context->flatSet,
+		    context->trie, context->automaton, context->doubleArray, context->dawg, context->bloomFilter,
+		    context->lengthMasks, &server.queryCache, context->maxWordLength);
+  openServeSocket(&server, socketPath);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stopServing;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  printf("Serving %lu words on %s.\n", (unsigned long)context->wordStorage->wordCount, socketPath.c_str());
+  fflush(stdout);
+
+  std::vector<struct pollfd> pollDescriptors;
+  while(!gServeStop) {
+    pollDescriptors.clear();
+    struct pollfd listenPoll = { server.listenDescriptor, POLLIN, 0 };
+    pollDescriptors.push_back(listenPoll);
+    for(size_t i = 0; i < server.clients.size(); i++) {
+      FLServeClient &client = server.clients[i];
+      short events = 0;
+      if(!client.closing && client.output.size() < kServeMaxOutput) events |= POLLIN;
+      if(!client.output.empty()) events |= POLLOUT;
+      struct pollfd clientPoll = { client.fileDescriptor, events, 0 };
+      pollDescriptors.push_back(clientPoll);
+    }
+    if(poll(pollDescriptors.data(), pollDescriptors.size(), -1) < 0) {
+      if(errno == EINTR) continue;
+      printf("ERROR:  poll() failed (%s).\n", strerror(errno));
+      break;
+    }
+
+    // Clients are handled before new ones are accepted, so the poll entries line up.
+    size_t keptClients = 0;
+    for(size_t i = 0; i < server.clients.size(); i++) {
+      FLServeClient &client = server.clients[i];
+      short events = pollDescriptors[i + 1].revents;
+      bool keep = true;
+      if(events & POLLIN)
+	keep = readServeClient(&server, &client);
+      else if(events & (POLLERR | POLLHUP | POLLNVAL))
+	keep = false;
+      if(keep)
+	keep = writeServeClient(&client);
+      if(keep) {
+	if(keptClients != i)
+	  server.clients[keptClients] = std::move(client);
+	keptClients++;
+      } else
+	close(client.fileDescriptor);
+    }
+    server.clients.resize(keptClients);
+
+    if(pollDescriptors[0].revents & POLLIN) {
+      int clientDescriptor;
+      while((clientDescriptor = accept(server.listenDescriptor, NULL, NULL)) >= 0) {
+	fcntl(clientDescriptor, F_SETFL, O_NONBLOCK);
+	FLServeClient client;
+	client.fileDescriptor = clientDescriptor;
+	client.batchRemaining = 0;
+	client.closing = false;
+	server.clients.push_back(std::move(client));
+      }
+    }
+  }
+
+  for(size_t i = 0; i < server.clients.size(); i++)
+    close(server.clients[i].fileDescriptor);
+  close(server.listenDescriptor);
+  unlink(server.socketPath.c_str());
+  printf("Served %lu requests.\n", server.requests);
+}
+
+// printUsage()
+// Requires:  bool, char*
+// Returns:   None
+// The function will print out the usage of the program, using argv[0] as the
 // name of the program.  If requested, the function will terminate the program.
 void printUsage(bool doExit, char* argv[]) {
-  printf("Usage: %s [-[d|h|s]] <word_input_text_file>\n", argv[0]);
+  printf("Usage: %s [-[d|h|s]] [-j N] [--top K] [--no-count] [--cache-mb=N] [--engine=hash|trie|dp|ac|dat|dawg] [--stream] [--alert-us=N] [--mmap] [--store=flat|stl] [--bloom-bits=N] [--simd=auto|avx2|sse2|scalar] [--stats] [--segments] [--compile out.fld] [--serve socket_path] <word_input_text_file>\n", argv[0]);
   printf("  The script must be called with a word input text file.\n");
   printf("  Optional arguments can be combined, can appear before or after the input file, and include:\n");
   printf("    -d:  enable printing of algorithm info for debug and analysis\n");
   printf("    -s:  sort input file before processing\n");
-  printf("    -h:  print this help information and exit\n\n");
+  printf("    -j N:  load and check words with N threads (0 for one per hardware thread)\n");
+  printf("    --top K:  report the K longest words made of other words (instead of first and second)\n");
+  printf("    --no-count:  skip the total count and stop once the longest words are found\n");
+  printf("    -h:  print this help information and exit\n");
+  printf("    --cache-mb=N:  byte budget for the suffix result cache, in MB (default %lu, 0 disables)\n",
+	 (unsigned long)kSuffixCacheMB);
+  printf("    --engine=hash|trie|dp|ac|dat|dawg:  check words with set lookups per prefix (default), trie walks,\n");
+  printf("                                        the bounded bottom-up word break (dp), one Aho-Corasick scan (ac),\n");
+  printf("                                        double-array trie walks (dat, kept in --compile snapshots),\n");
+  printf("                                        or minimal automaton (DAWG) walks (dawg)\n");
+  printf("    --stream:  with --engine=dawg, build the DAWG while loading a sorted word input text file;\n");
+  printf("               a word out of order switches to building it from the sorted words after loading\n");
+  printf("    --alert-us=N:  report words that take more than N microseconds to check\n");
+  printf("    --mmap:  load the input file through a memory mapping instead of line by line reads\n");
+  printf("    --store=flat|stl:  look words up in the open addressing set (default) or the STL set\n");
+  printf("    --bloom-bits=N:  with the hash and dp engines, check a Bloom filter of N bits per word\n");
+  printf("                     before each lookup (default 0, no filter)\n");
+  printf("    --simd=auto|avx2|sse2|scalar:  find and clean lines with the given ingest kernel\n");
+  printf("                                    (default auto, the widest the CPU supports)\n");
+  printf("    --stats:  print phase times and search counters as stats.<name>=<value> lines\n");
+  printf("    --segments:  before the results, print every compound with its number of decompositions\n");
+  printf("                 and its segmentation DAG (split positions, and edges as start-end pairs)\n");
+  printf("    --compile out.fld:  write the loaded dictionary to a binary snapshot and exit;\n");
+  printf("                        a snapshot can be passed instead of the word input text file\n");
+  printf("    --serve socket_path:  load the dictionary once and answer queries on a Unix domain socket\n");
+  printf("                          until interrupted, one request per line (responses in order):\n");
+  printf("                            CHECK <word>, HAS <word>:  1 or 0\n");
+  printf("                            BATCH <n>, then n words:  one line of n results (1 or 0)\n");
+  printf("                            ADD <word>, DEL <word>:  1, or 0 if unchanged (not with ac, dat, dawg)\n");
+  printf("                            TOP <k>:  the number of words n, then the n longest compounds\n");
+  printf("                            COUNT:  the number of compounds\n");
+  printf("                            STATS, PING, QUIT\n\n");
   if(doExit)
     exit(1);
 }
 
+// parseLongOption()
+// Requires:  std::string reference, int, char*, int reference
+// Returns:   None
+// The function handles one "--name=value" or "--name value" argument (without the
+// leading dashes).  For the second form, it takes the next argument as the value and
+// advances the argument index; flags without values (mmap, no-count, stats, segments,
+// stream) never do.
+// Unknown names and malformed values cause failure.
+void parseLongOption(std::string &option, int argc, char* argv[], int &carg) {
+  size_t equalsPos = option.find('=');
+  std::string name = option.substr(0, equalsPos);
+  std::string value = (equalsPos == std::string::npos) ? "" : option.substr(equalsPos + 1);
+  bool isFlag = (name == "mmap" || name == "no-count" || name == "stats" || name == "segments" ||
+		 name == "stream");
+  char *valueEnd;
+  if(!isFlag && equalsPos == std::string::npos && carg + 1 < argc)
+    value = argv[++carg];
+
+  if(name == "cache-mb") {
+    kSuffixCacheMB = strtoul(value.c_str(), &valueEnd, 10);
+    if(value.empty() || *valueEnd != '\0') {
+      printf("ERROR:  --cache-mb requires a number of megabytes.\n");
+      printUsage(true, argv);
+    }
+  } else if(name == "engine") {
+    if(value == "hash")
+      kEngine = kEngineHash;
+    else if(value == "trie")
+      kEngine = kEngineTrie;
+    else if(value == "dp")
+      kEngine = kEngineDP;
+    else if(value == "ac")
+      kEngine = kEngineAC;
+    else if(value == "dat")
+      kEngine = kEngineDoubleArray;
+    else if(value == "dawg")
+      kEngine = kEngineDawg;
+    else {
+      printf("ERROR:  %s is not a valid engine.\n", value.c_str());
+      printUsage(true, argv);
+    }
+  } else if(name == "mmap" && equalsPos == std::string::npos) {
+    kDoMmap = true;
+  } else if(name == "no-count" && equalsPos == std::string::npos) {
+    kDoCount = false;
+  } else if(name == "stats" && equalsPos == std::string::npos) {
+    kDoStats = true;
+  } else if(name == "segments" && equalsPos == std::string::npos) {
+    kDoSegments = true;
+  } else if(name == "stream" && equalsPos == std::string::npos) {
+    kDoStream = true;
+  } else if(name == "compile") {
+    if(value.empty()) {
+      printf("ERROR:  --compile requires an output file name.\n");
+      printUsage(true, argv);
+    }
+    kCompileName = value;
+  } else if(name == "serve") {
+    if(value.empty()) {
+      printf("ERROR:  --serve requires a socket path.\n");
+      printUsage(true, argv);
+    }
+    kServePath = value;
+  } else if(name == "top") {
+    long topCount = strtol(value.c_str(), &valueEnd, 10);
+    if(value.empty() || *valueEnd != '\0' || topCount < 1) {
+      printf("ERROR:  --top requires a positive number of words.\n");
+      printUsage(true, argv);
+    }
+    kTopCount = topCount;
+    kDoTopList = true;
+  } else if(name == "simd") {
+    FLIngestKernel kernel = kIngestAuto;
+    while(kernel <= kIngestAVX2 && value != kIngestNames[kernel])
+      kernel = (FLIngestKernel)(kernel + 1);
+    if(kernel > kIngestAVX2) {
+      printf("ERROR:  %s is not a valid ingest kernel.\n", value.c_str());
+      printUsage(true, argv);
+    }
+    if(!selectIngestKernel(kernel)) {
+      printf("ERROR:  The %s ingest kernel is not supported on this CPU.\n", value.c_str());
+      exit(1);
+    }
+  } else if(name == "store") {
+    if(value == "flat")
+      kStore = kStoreFlat;
+    else if(value == "stl")
+      kStore = kStoreSTL;
+    else {
+      printf("ERROR:  %s is not a valid store.\n", value.c_str());
+      printUsage(true, argv);
+    }
+  } else if(name == "bloom-bits") {
+    kBloomBitsPerKey = strtoul(value.c_str(), &valueEnd, 10);
+    if(value.empty() || *valueEnd != '\0' || kBloomBitsPerKey > 64) {
+      printf("ERROR:  --bloom-bits requires a number of bits per word from 0 to 64.\n");
+      printUsage(true, argv);
+    }
+  } else if(name == "alert-us") {
+    kAlertMicros = strtol(value.c_str(), &valueEnd, 10);
+    if(value.empty() || *valueEnd != '\0' || kAlertMicros < 0) {
+      printf("ERROR:  --alert-us requires a number of microseconds.\n");
+      printUsage(true, argv);
+    }
+  } else {
+    printf("ERROR:  --%s is not a valid option.\n", name.c_str());
+    printUsage(true, argv);
+  }
+}
+
 // parseArguments()
 // Requires:  int, char*, std::string reference
 // Returns:   None
 // The function checks all the (argc) arguments in argv[].
 // For any argument with a leading dash, it collects all the
 // following characters, checks them for validity, and handles them.
+// The -j option takes the rest of the argument, or the next argument, as its value.
+// Arguments with two leading dashes are handled by parseLongOption().
 // Invalid options cause failure.
 // On successful parsing of a word without a leading dash, it will store
 // the word in the provided string reference.  Multiple blind words cause failure.
@@ -431,7 +4445,10 @@ void parseArguments(int argc, char* argv[], std::string &fileName) {
   int carg, cargIndex, argLength;
   for(carg = 1; carg < argc; carg++) {
     std::string argstr = argv[carg];
-    if(strncmp(&argstr[0], "-", 1) == 0) {
+    if(strncmp(&argstr[0], "--", 2) == 0) {
+      std::string option = argstr.substr(2);
+      parseLongOption(option, argc, argv, carg);
+    } else if(strncmp(&argstr[0], "-", 1) == 0) {
       if((argLength = argstr.length()) == 1)
 	printUsage(true, argv);
       for(cargIndex = 1; cargIndex < argLength; cargIndex++) {
@@ -441,7 +4458,21 @@ void parseArguments(int argc, char* argv[], std::string &fileName) {
 	  kDoDebug = true;
 	else if(strncmp(&argstr[cargIndex], "s", 1) == 0)
 	  kDoPreSort = true;
-	else {
+	else if(strncmp(&argstr[cargIndex], "j", 1) == 0) {
+	  // Thread count follows directly (-j8) or as the next argument (-j 8).
+	  std::string countStr = argstr.substr(cargIndex + 1);
+	  if(countStr.empty() && carg + 1 < argc)
+	    countStr = argv[++carg];
+	  char *countEnd;
+	  kThreadCount = strtol(countStr.c_str(), &countEnd, 10);
+	  if(countStr.empty() || *countEnd != '\0' || kThreadCount < 0) {
+	    printf("ERROR:  -j requires a number of threads.\n");
+	    printUsage(true, argv);
+	  }
+	  if(kThreadCount == 0)
+	    kThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	  break;
+	} else {
 	  printf("ERROR:  %c is not a valid option.\n", argstr[cargIndex]);
 	  printUsage(true, argv);
 	}
@@ -458,31 +4489,144 @@ void parseArguments(int argc, char* argv[], std::string &fileName) {
     printUsage(true, argv);
 }
 
+#ifndef FL_NO_MAIN
 // main()
 // Requires:  int, char*
 // Returns:   int
-// Top level function holds the file name string and pointers to the size hash and
-// string set.  It parses the arguments and attempts to create the size hash and
-// string set from the words in the provided file.  If successful, it retrieves
+// Top level function holds the file name string and pointers to the size hash, word
+// storage, and lookup structures.  It parses the arguments and attempts to create the
+// size hash, word storage, and flat set from the words in the provided file, then
+// replaces the flat set with the trie or string set if the engine or store needs
+// one instead.  A snapshot file is mapped instead, and with --compile, the loaded
+// dictionary is written to a snapshot instead of searched; with --serve, it answers
+// queries on a socket instead (serveDictionary()).  If successful, it retrieves
 // a count of the words made from other words in the file, and saves the first
-// and second longest words it finds.  It prints out the results and then cleans
-// up the manually allocated objects (via "new" in hashStringFile()).
+// and second longest words it finds (or the --top K longest, as a list).
+// It prints out the results and then cleans
+// up the manually allocated objects (via "new" in hashStringFile() or mapStringFile()).
+// With debug enabled, it also prints the suffix cache and search counters, and
+// with --stats, the phase times and counters from printStats().
 int main(int argc, char* argv[]) {
   std::string fileName = "";
   FLLengthMap *sizeHash;
-  FLStringSet *stringSet;
+  FLStringSet *stringSet = NULL;
+  FLWordStorage *wordStorage;
+  FLTrie *trie = NULL;
+  FLAutomaton *automaton = NULL;
+  FLDoubleArray *doubleArray = NULL;
+  FLDawg *dawg = NULL;
+  FLBloomFilter *bloomFilter = NULL;
+  FLLengthMasks *lengthMasks = NULL;
+  FLFlatSet *flatSet = NULL;
+  FLSuffixCache suffixCache;
 
+  FLPhaseClock phaseClock;
+
+  selectIngestKernel(kIngestAuto);
   parseArguments(argc, argv, fileName);
-  if(hashStringFile(fileName, &sizeHash, &stringSet)) {
-    std::string firstWord;
-    std::string secondWord;
-    int count = findLongestWordsOfWords(stringSet, sizeHash, firstWord, secondWord);
-    printf("First word found is %s, second word found is %s, total count found is %d.\n",
-	   firstWord.c_str(), secondWord.c_str(), count);
+  startPhase(&phaseClock);
+  bool loaded;
+  bool isSnapshot = isSnapshotFile(fileName);
+  FLDawgBuilder dawgStream;
+  if(kDoStream && kEngine == kEngineDawg && !isSnapshot && kCompileName.empty()) {
+    initDawgBuilder(&dawgStream);
+    gDawgStream = &dawgStream;
+  }
+  if(isSnapshot)
+    loaded = mapSnapshotFile(fileName, &sizeHash, &flatSet, &wordStorage, &doubleArray);
+  else if(kDoMmap)
+    loaded = mapStringFile(fileName, &sizeHash, &flatSet, &wordStorage);
+  else
+    loaded = hashStringFile(fileName, &sizeHash, &flatSet, &wordStorage);
+  if(gDawgStream != NULL) {
+    dawg = finishDawg(gDawgStream);
+    gDawgStream = NULL;
+    gLoadStats.sortedInput = true;
+  }
+  endPhase(&phaseClock, kPhaseLoad);
+  if(loaded && !kCompileName.empty()) {
+    if(kEngine == kEngineDoubleArray && doubleArray == NULL)
+      doubleArray = buildDoubleArrayFromWords(wordStorage);
+    if(writeSnapshotFile(kCompileName, sizeHash, flatSet, wordStorage, doubleArray))
+      printf("Compiled %lu words into %s.\n", (unsigned long)wordStorage->wordCount, kCompileName.c_str());
+  } else if(loaded) {
+    startPhase(&phaseClock);
+    // The flat set is only needed for loading (duplicates) by the trie, double-array, and
+    // dawg engines and the STL store.  The ac engine keeps its store for the lookups of the server.
+    if(kEngine == kEngineTrie)
+      trie = buildTrieFromWords(wordStorage);
+    else if(kEngine == kEngineDoubleArray) {
+      if(doubleArray == NULL)
+	doubleArray = buildDoubleArrayFromWords(wordStorage);
+    } else if(kEngine == kEngineDawg) {
+      if(dawg == NULL)
+	dawg = buildDawgFromWords(wordStorage);
+    } else if(kStore == kStoreSTL)
+      stringSet = buildStringSetFromWords(wordStorage);
+    if(kEngine == kEngineAC)
+      automaton = buildAutomatonFromWords(wordStorage);
+    if(kBloomBitsPerKey > 0 && (kEngine == kEngineHash || kEngine == kEngineDP))
+      bloomFilter = buildBloomFilterFromWords(wordStorage, kBloomBitsPerKey);
+    lengthMasks = buildLengthMasks(sizeHash, wordStorage);
+    if(trie != NULL || doubleArray != NULL || dawg != NULL || stringSet != NULL) {
+      delete flatSet;
+      flatSet = NULL;
+    }
+    size_t wordCount = wordStorage->wordCount;
+    // The search threads of -j have their own caches; their counters are added to this one.
+    initSuffixCache(&suffixCache, kThreadCount > 1 ? 0 : (kSuffixCacheMB << 20), wordCount);
+    FLSearchContext context;
+    initSearchContext(&context, wordStorage, stringSet, flatSet, trie, automaton, doubleArray, dawg,
+		      bloomFilter, lengthMasks, &suffixCache, longestWordLength(sizeHash));
+    endPhase(&phaseClock, kPhaseIndex);
+    if(!kServePath.empty())
+      serveDictionary(kServePath, &context, sizeHash, wordStorage);
+    else {
+      if(kDoSegments)
+	printSegmentations(&context, sizeHash);
+      std::vector<std::string> topWords;
+      int count = findLongestWordsOfWords(&context, sizeHash, topWords);
+      if(kDoTopList) {
+	for(size_t i = 0; i < topWords.size(); i++)
+	  printf("Word %lu found is %s, length %lu.\n", (unsigned long)(i + 1), topWords[i].c_str(),
+		 (unsigned long)topWords[i].length());
+	if(kDoCount) printf("Total count found is %d.\n", count);
+      } else {
+	topWords.resize(2);
+	if(kDoCount)
+	  printf("First word found is %s, second word found is %s, total count found is %d.\n",
+		 topWords[0].c_str(), topWords[1].c_str(), count);
+	else
+	  printf("First word found is %s, second word found is %s.\n", topWords[0].c_str(), topWords[1].c_str());
+      }
+      if(kDoDebug) {
+	printf("Suffix cache:  %lu hits, %lu misses, %lu entries, %lu bytes, %lu dropped.\n",
+	       suffixCache.hits, suffixCache.misses, (unsigned long)suffixCache.entries,
+	       (unsigned long)suffixCache.bytes, suffixCache.dropped);
+	FLSearchStats &stats = context.stats;
+	printf("Search:  %lu words tested, %lu lookups (%.2f per word, max %lu), %lu trie node steps, %lu alerts.\n",
+	       stats.wordsTested, stats.lookups,
+	       stats.wordsTested ? (double)stats.lookups / stats.wordsTested : 0.0,
+	       stats.maxLookupsPerWord, stats.trieNodeSteps, stats.alerts);
+	printf("Hashing:  %lu characters hashed (%.2f per word).\n", stats.hashedChars,
+	       stats.wordsTested ? (double)stats.hashedChars / stats.wordsTested : 0.0);
+	printf("Allocations:  %lu during the search loop (%.4f per word).\n", stats.allocations,
+	       stats.wordsTested ? (double)stats.allocations / stats.wordsTested : 0.0);
+      }
+      if(kDoStats)
+	printStats(&context, &suffixCache, count);
+    }
   }
 
+  delete trie;
+  delete automaton;
+  delete doubleArray;
+  delete dawg;
+  delete bloomFilter;
+  delete lengthMasks;
+  delete flatSet;
   delete stringSet;
   delete sizeHash;
+  deleteWordStorage(wordStorage);
 }
-
-
+#endif
@@ -0,0 +1,364 @@
+// Synthetic word list generator for findLongest.cpp
+//
+// Compilation:
+//   g++ -std=c++11 -O2 genWordList.cpp -o genWordList
+//
+// Usage:  genWordList [options] [--output FILE]
+// Writes one lower case word per line, to standard output unless --output is given.
+// Options take "--name=value" or "--name value":
+//   --words N              number of random words (default 1000000); the adversarial words
+//                          below are added to these.  10M - 100M for scaling runs.
+//   --min-length N         shortest base word (default 2)
+//   --max-length N         longest base word (default 12, at most 255)
+//   --mean-length X        draw base word lengths from a normal distribution around X
+//                          (clamped to the min and max) instead of a uniform one
+//   --compound-fraction F  fraction of the words that are compounds (default 0.5)
+//   --max-parts N          compounds join 2 to N base words (default 4)
+//   --alphabet N           number of letters used, from 'a' (1 to 26, default 26)
+//   --runs N               adversarial families (default 0, fewer than the alphabet size):
+//                          family k repeats letter k 1 .. R times and adds the run of R
+//                          followed by the last letter of the alphabet, which is then
+//                          reserved (no random word uses it).  That word makes greedy
+//                          checkers backtrack through every split of the run, and is
+//                          never a compound, since no other word holds its last letter.
+//   --run-length R         longest run in each family (default 30)
+//   --unsorted             write the words in generation order (duplicates possible)
+//                          instead of sorted with duplicates removed
+//   --seed N               random seed (default 1); equal options and seeds give equal lists
+//
+// Notes:
+// (1) Compounds are made of base words generated earlier.  Up to kBasePoolSize base words
+//     are kept for them (a uniform reservoir sample once the pool is full), so unsorted
+//     output streams in constant memory at any size.
+// (2) Sorted output holds every word in one character arena with an array of packed
+//     (offset, length) entries, about 8 bytes plus the characters per word, so 100M words
+//     of average length 10 need about 2 GB.
+// (3) Letters are taken 8 at a time from one 64 bit random number.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// -----------------------------------------------------------------
+
+// Generator options, set by parseArguments().
+static unsigned long kWordCount = 1000000;
+static size_t kMinLength = 2;
+static size_t kMaxLength = 12;
+static double kMeanLength = 0.0;
+static double kCompoundFraction = 0.5;
+static size_t kMaxParts = 4;
+static unsigned kAlphabetSize = 26;
+static unsigned kRunFamilies = 0;
+static size_t kRunLength = 30;
+static bool kDoSort = true;
+static unsigned long kSeed = 1;
+static std::string kOutputName = "";
+
+// Longest word written (entries pack the length into 8 bits) and the number of base words
+// kept for compounds.
+static const size_t kMaxWordLength = 255;
+static const size_t kBasePoolSize = 1 << 20;
+
+// Random source of the generator.  letterBits holds unused random bytes for letters,
+// drawn from the first letterCount letters.
+struct GWGenerator {
+  std::mt19937_64 random;
+  uint64_t letterBits;
+  int lettersLeft;
+  unsigned letterCount;
+  std::vector<char> basePool;
+  std::vector<uint64_t> baseEntries;
+  unsigned long baseCount;
+};
+
+// Words kept for sorted output:  characters back to back, and (offset << 8 | length) entries.
+struct GWWordList {
+  std::vector<char> arena;
+  std::vector<uint64_t> entries;
+};
+
+// -----------------------------------------------------------------
+
+// Function declarations, in definition order.
+char randomLetter(GWGenerator *generator);
+size_t randomBaseLength(GWGenerator *generator);
+void makeBaseWord(GWGenerator *generator, std::string &word);
+void makeCompoundWord(GWGenerator *generator, std::string &word);
+void keepBaseWord(GWGenerator *generator, const std::string &word);
+void addWord(GWWordList *wordList, FILE *output, const std::string &word);
+unsigned long writeSortedWords(GWWordList *wordList, FILE *output);
+void printUsage(bool doExit, char* argv[]);
+void parseArguments(int argc, char* argv[]);
+int main(int argc, char* argv[]);
+
+// -----------------------------------------------------------------
+
+// randomLetter()
+// Requires:  GWGenerator *
+// Returns:   char
+// Returns a letter from the first letterCount letters, using the next random byte.
+char randomLetter(GWGenerator *generator) {
+  if(generator->lettersLeft == 0) {
+    generator->letterBits = generator->random();
+    generator->lettersLeft = 8;
+  }
+  unsigned byte = generator->letterBits & 0xff;
+  generator->letterBits >>= 8;
+  generator->lettersLeft--;
+  return 'a' + (byte * generator->letterCount >> 8);
+}
+
+// randomBaseLength()
+// Requires:  GWGenerator *
+// Returns:   size_t
+// Returns a base word length between kMinLength and kMaxLength:  uniform, or normal
+// around kMeanLength (standard deviation of a sixth of the range) and clamped.
+size_t randomBaseLength(GWGenerator *generator) {
+  if(kMeanLength <= 0.0)
+    return kMinLength + generator->random() % (kMaxLength - kMinLength + 1);
+  std::normal_distribution<double> lengths(kMeanLength, std::max(1.0, (kMaxLength - kMinLength) / 6.0));
+  double length = lengths(generator->random) + 0.5;
+  return std::min((double)kMaxLength, std::max((double)kMinLength, length));
+}
+
+// makeBaseWord()
+// Requires:  GWGenerator *, std::string reference
+// Returns:   None
+// Replaces the word with random letters, of a length from randomBaseLength().
+void makeBaseWord(GWGenerator *generator, std::string &word) {
+  word.resize(randomBaseLength(generator));
+  for(size_t i = 0; i < word.length(); i++)
+    word[i] = randomLetter(generator);
+}
+
+// makeCompoundWord()
+// Requires:  GWGenerator * (with a non-empty base pool), std::string reference
+// Returns:   None
+// Replaces the word with 2 to kMaxParts base words from the pool, joined.  Parts that
+// would make the word longer than kMaxWordLength are left out.
+void makeCompoundWord(GWGenerator *generator, std::string &word) {
+  size_t parts = 2 + generator->random() % (kMaxParts - 1);
+  size_t poolWords = generator->baseEntries.size();
+  word.clear();
+  for(size_t i = 0; i < parts; i++) {
+    uint64_t entry = generator->baseEntries[generator->random() % poolWords];
+    size_t length = entry & 0xff;
+    if(word.length() + length > kMaxWordLength) break;
+    word.append(&generator->basePool[entry >> 8], length);
+  }
+}
+
+// keepBaseWord()
+// Requires:  GWGenerator *, std::string reference
+// Returns:   None
+// Adds the base word to the pool for compounds.  Once the pool holds kBasePoolSize
+// words, the word replaces a random one with probability kBasePoolSize / baseCount
+// (reservoir sampling), so the pool stays a uniform sample of all base words.
+// The pool keeps kMaxLength bytes per slot, so replacements fit in place.
+void keepBaseWord(GWGenerator *generator, const std::string &word) {
+  generator->baseCount++;
+  size_t slot;
+  if(generator->baseEntries.size() < kBasePoolSize) {
+    slot = generator->baseEntries.size();
+    generator->baseEntries.push_back(0);
+    generator->basePool.resize((slot + 1) * kMaxLength);
+  } else {
+    slot = generator->random() % generator->baseCount;
+    if(slot >= kBasePoolSize) return;
+  }
+  memcpy(&generator->basePool[slot * kMaxLength], word.data(), word.length());
+  generator->baseEntries[slot] = (uint64_t)(slot * kMaxLength) << 8 | word.length();
+}
+
+// addWord()
+// Requires:  GWWordList *, FILE *, std::string reference
+// Returns:   None
+// Writes the word to the output, or keeps it in the word list for sorted output.
+void addWord(GWWordList *wordList, FILE *output, const std::string &word) {
+  if(!kDoSort) {
+    fwrite(word.data(), 1, word.length(), output);
+    fputc('\n', output);
+    return;
+  }
+  wordList->entries.push_back((uint64_t)wordList->arena.size() << 8 | word.length());
+  wordList->arena.insert(wordList->arena.end(), word.begin(), word.end());
+}
+
+// writeSortedWords()
+// Requires:  GWWordList *, FILE *
+// Returns:   unsigned long
+// Sorts the kept words, writes them without duplicates, and returns the number of
+// duplicates removed.
+unsigned long writeSortedWords(GWWordList *wordList, FILE *output) {
+  const char *arena = wordList->arena.data();
+  std::sort(wordList->entries.begin(), wordList->entries.end(), [arena](uint64_t a, uint64_t b) {
+      size_t aLength = a & 0xff, bLength = b & 0xff;
+      int result = memcmp(arena + (a >> 8), arena + (b >> 8), std::min(aLength, bLength));
+      return (result < 0) || (result == 0 && aLength < bLength);
+    });
+  unsigned long duplicates = 0;
+  for(size_t i = 0; i < wordList->entries.size(); i++) {
+    uint64_t entry = wordList->entries[i];
+    size_t length = entry & 0xff;
+    if(i > 0) {
+      uint64_t previous = wordList->entries[i - 1];
+      if((previous & 0xff) == length && memcmp(arena + (previous >> 8), arena + (entry >> 8), length) == 0) {
+	duplicates++;
+	continue;
+      }
+    }
+    fwrite(arena + (entry >> 8), 1, length, output);
+    fputc('\n', output);
+  }
+  return duplicates;
+}
+
+// printUsage()
+// Requires:  bool, char*
+// Returns:   None
+// Prints the usage of the program, using argv[0] as its name, and exits if requested.
+void printUsage(bool doExit, char* argv[]) {
+  printf("Usage: %s [--words N] [--min-length N] [--max-length N] [--mean-length X]\n", argv[0]);
+  printf("         [--compound-fraction F] [--max-parts N] [--alphabet N] [--runs N] [--run-length R]\n");
+  printf("         [--unsorted] [--seed N] [--output FILE]\n");
+  printf("  Writes a synthetic word list for findLongest, one word per line (see the notes at the\n");
+  printf("  top of genWordList.cpp for the meaning of each option).\n\n");
+  if(doExit)
+    exit(1);
+}
+
+// parseArguments()
+// Requires:  int, char*
+// Returns:   None
+// Handles "--name=value" and "--name value" options (--unsorted takes no value), and
+// checks that the values are in range.  Unknown options and bad values cause failure.
+void parseArguments(int argc, char* argv[]) {
+  for(int carg = 1; carg < argc; carg++) {
+    std::string argstr = argv[carg];
+    if(argstr.compare(0, 2, "--") != 0) {
+      printf("ERROR:  %s is not a valid option.\n", argstr.c_str());
+      printUsage(true, argv);
+    }
+    size_t equalsPos = argstr.find('=');
+    std::string name = argstr.substr(2, equalsPos == std::string::npos ? std::string::npos : equalsPos - 2);
+    if(name == "unsorted" && equalsPos == std::string::npos) {
+      kDoSort = false;
+      continue;
+    }
+    if(name == "help" || name == "h")
+      printUsage(true, argv);
+    std::string value;
+    if(equalsPos != std::string::npos)
+      value = argstr.substr(equalsPos + 1);
+    else if(carg + 1 < argc)
+      value = argv[++carg];
+    char *valueEnd;
+    double number = strtod(value.c_str(), &valueEnd);
+    bool isNumber = !value.empty() && *valueEnd == '\0' && number >= 0;
+
+    if(name == "output")
+      kOutputName = value;
+    else if(!isNumber) {
+      printf("ERROR:  --%s requires a non-negative number.\n", name.c_str());
+      printUsage(true, argv);
+    } else if(name == "words")
+      kWordCount = number;
+    else if(name == "min-length")
+      kMinLength = number;
+    else if(name == "max-length")
+      kMaxLength = number;
+    else if(name == "mean-length")
+      kMeanLength = number;
+    else if(name == "compound-fraction")
+      kCompoundFraction = number;
+    else if(name == "max-parts")
+      kMaxParts = number;
+    else if(name == "alphabet")
+      kAlphabetSize = number;
+    else if(name == "runs")
+      kRunFamilies = number;
+    else if(name == "run-length")
+      kRunLength = number;
+    else if(name == "seed")
+      kSeed = number;
+    else {
+      printf("ERROR:  --%s is not a valid option.\n", name.c_str());
+      printUsage(true, argv);
+    }
+  }
+
+  if(kMinLength < 1 || kMaxLength < kMinLength || kMaxLength > kMaxWordLength) {
+    printf("ERROR:  Lengths must satisfy 1 <= min-length <= max-length <= %lu.\n", (unsigned long)kMaxWordLength);
+    printUsage(true, argv);
+  }
+  if(kAlphabetSize < 1 || kAlphabetSize > 26 || (kRunFamilies > 0 && kRunFamilies >= kAlphabetSize) || kCompoundFraction > 1.0
+     || kMaxParts < 2 || kRunLength < 1 || kRunLength >= kMaxWordLength) {
+    printf("ERROR:  Option out of range (alphabet 1-26, runs < alphabet, compound fraction <= 1,\n");
+    printf("        max-parts >= 2, run-length 1-%lu).\n", (unsigned long)(kMaxWordLength - 1));
+    printUsage(true, argv);
+  }
+}
+
+// main()
+// Requires:  int, char*
+// Returns:   int
+// Generates kWordCount words, each a compound (with probability kCompoundFraction, once
+// there are base words) or a new base word, then the adversarial run families.
+// Unsorted words are written as they are made; sorted ones at the end.
+// A summary of the counts goes to standard error.
+int main(int argc, char* argv[]) {
+  parseArguments(argc, argv);
+  FILE *output = stdout;
+  if(!kOutputName.empty() && (output = fopen(kOutputName.c_str(), "w")) == NULL) {
+    printf("ERROR:  Couldn't open file %s for output.\n", kOutputName.c_str());
+    exit(1);
+  }
+  static char outputBuffer[1 << 20];
+  setvbuf(output, outputBuffer, _IOFBF, sizeof(outputBuffer));
+
+  GWGenerator generator;
+  generator.random.seed(kSeed);
+  generator.lettersLeft = 0;
+  // The run families end in the last letter, so random words leave it out.
+  generator.letterCount = kRunFamilies > 0 ? kAlphabetSize - 1 : kAlphabetSize;
+  generator.baseCount = 0;
+  GWWordList wordList;
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  unsigned long compoundCount = 0;
+  std::string word;
+
+  for(unsigned long i = 0; i < kWordCount; i++) {
+    if(generator.baseCount > 0 && unit(generator.random) < kCompoundFraction) {
+      makeCompoundWord(&generator, word);
+      compoundCount++;
+    } else {
+      makeBaseWord(&generator, word);
+      keepBaseWord(&generator, word);
+    }
+    addWord(&wordList, output, word);
+  }
+
+  char terminator = 'a' + kAlphabetSize - 1;
+  for(unsigned family = 0; family < kRunFamilies; family++) {
+    char letter = 'a' + family;
+    for(size_t length = 1; length <= kRunLength; length++)
+      addWord(&wordList, output, std::string(length, letter));
+    addWord(&wordList, output, std::string(kRunLength, letter) + terminator);
+  }
+
+  unsigned long duplicates = kDoSort ? writeSortedWords(&wordList, output) : 0;
+  if(fclose(output) != 0) {
+    fprintf(stderr, "ERROR:  Couldn't write the output.\n");
+    exit(1);
+  }
+  fprintf(stderr, "Generated %lu words (%lu base, %lu compounds, %lu in run families), %lu duplicates removed.\n",
+	  kWordCount + kRunFamilies * (kRunLength + 1), kWordCount - compoundCount, compoundCount,
+	  (unsigned long)kRunFamilies * (kRunLength + 1), duplicates);
+  return 0;
+}